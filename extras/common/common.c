@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <assert.h>
 #include "libs/tinycthread.h"
 
 #define TINA_IMPLEMENTATION
@@ -10,54 +11,18 @@
 
 #include "common.h"
 
-#if defined(__unix__) || defined(__APPLE__)
-	#include <unistd.h>
-	static unsigned common_get_cpu_count(void){return sysconf(_SC_NPROCESSORS_ONLN);}
-#elif defined(_WINDOWS_)
-	static unsigned common_get_cpu_count(void){
-		SYSTEM_INFO sysinfo;
-		GetSystemInfo(&sysinfo);
-		return sysinfo.dwNumberOfProcessors;
-	}
-#else
-	#error TODO Unhandled/unknown system type.
-#endif
-
-typedef struct {
-	thrd_t thread;
-	tina_scheduler* sched;
-	unsigned queue_idx;
-	unsigned thread_id;
-} worker_context;
-
-#define MAX_WORKERS 256
-static unsigned WORKER_COUNT;
-worker_context WORKERS[MAX_WORKERS];
-
-static int common_worker_body(void* data){
-	worker_context* ctx = data;
-	tina_scheduler_run(ctx->sched, ctx->queue_idx, TINA_RUN_LOOP);
-	return 0;
-}
+static tina_workers* WORKERS;
 
 void common_start_worker_threads(unsigned thread_count, tina_scheduler* sched, unsigned queue_idx){
-	if(thread_count){
-		WORKER_COUNT = thread_count;
-	} else {
-		WORKER_COUNT = common_get_cpu_count();
-		printf("%d CPUs detected.\n", WORKER_COUNT);
-	}
-	
 	puts("Creating WORKERS.");
-	for(unsigned i = 0; i < WORKER_COUNT; i++){
-		worker_context* worker = WORKERS + i;
-		(*worker) = (worker_context){.sched = sched, .queue_idx = queue_idx, .thread_id = i};
-		thrd_create(&worker->thread, common_worker_body, worker);
-	}
+	WORKERS = tina_workers_start(sched, queue_idx, thread_count, TINA_AFFINITY_NONE, "tina-worker");
+	assert(WORKERS && "Failed to start worker threads.");
+	if(thread_count == 0) printf("%u CPUs detected, %u worker threads started.\n", tina_workers_cpu_count(TINA_AFFINITY_NONE), tina_workers_count(WORKERS));
 }
 
-unsigned common_worker_count(void){return WORKER_COUNT;}
+unsigned common_worker_count(void){return tina_workers_count(WORKERS);}
 
 void common_destroy_worker_threads(){
-	for(unsigned i = 0; i < WORKER_COUNT; i++) thrd_join(WORKERS[i].thread, NULL);
+	tina_workers_stop(WORKERS);
+	WORKERS = NULL;
 }
@@ -299,6 +299,7 @@ static void generate_tile_job(tina_job* job){
 	// OK! Now for the exciting part!
 	// Loop through all the pixels and subsamples (for anti-aliasing).
 	// Break them into batches of SAMPLE_BATCH_COUNT size, and create tasks to render them.
+	// These stay separate jobs instead of a tina_parallel_for() so the tile can be uploaded as each batch finishes.
 	unsigned batch_cursor = 0;
 	while(batch_cursor < 256){
 		tina_scheduler_enqueue(SCHED, "RenderSamples", render_samples_job, &render_context, batch_cursor, queue, &group);
@@ -447,10 +448,13 @@ static bool visit_tile(tile_node* node, tile_node** request_queue){
 	return false;
 }
 
+// Tracks the tiles being generated, and throttles how many are in flight.
+static tina_group TILE_GROUP;
+
 static void app_display(void){
-	// Run jobs to load textures.
+	// Run jobs to load textures. Limit the uploads to 2 ms a frame, the rest wait for the next one.
 	tina_scheduler_run(SCHED, QUEUE_GFX_WAIT, TINA_RUN_FLUSH);
-	tina_scheduler_run(SCHED, QUEUE_GFX, TINA_RUN_FLUSH);
+	tina_scheduler_run_limited(SCHED, QUEUE_GFX, TINA_RUN_BUDGET, &(tina_run_limits){.nanoseconds = 2000000});
 	TIMESTAMP++;
 	
 	int w = sapp_width(), h = sapp_height();
@@ -473,10 +477,9 @@ static void app_display(void){
 	tile_node* request_queue[REQUEST_QUEUE_LENGTH] = {};
 	visit_tile(&TREE_ROOT, request_queue);
 	
-	static tina_group tile_throttle_group = {};
 	for(int i = 0; i < REQUEST_QUEUE_LENGTH && request_queue[i]; i++){
 		tina_job_description desc = {.name = "GenTiles", .func = generate_tile_job, .user_data = request_queue[i], .queue_idx = QUEUE_WORK};
-		if(!tina_scheduler_enqueue_batch(SCHED, &desc, 1, &tile_throttle_group, 8)) break;
+		if(!tina_scheduler_enqueue_batch(SCHED, &desc, 1, &TILE_GROUP, 8)) break;
 		request_queue[i]->status = TILE_STATUS_REQUESTED;
 	}
 	
@@ -568,10 +571,15 @@ static void app_init(void){
 
 static void app_cleanup(void){
 	puts("Sokol-App cleanup.");
-	// tina_job_wait_sleep(SCHED, &group, 0);
+	TIMESTAMP += 1000;
+	
+	// Finish the tiles in flight. Their uploads need the graphics queues, so run them on this thread while waiting.
+	// Bumping TIMESTAMP keeps uploads from waiting on QUEUE_GFX_WAIT again, so flushing it moves the rest to QUEUE_GFX.
+	puts("Waiting for tiles.");
+	tina_scheduler_run(SCHED, QUEUE_GFX_WAIT, TINA_RUN_FLUSH);
+	tina_group_wait_blocking(SCHED, &TILE_GROUP, 0, QUEUE_GFX);
 	
 	puts("WORKERS shutdown.");
-	TIMESTAMP += 1000;
 	tina_scheduler_interrupt(SCHED, QUEUE_WORK);
 	common_destroy_worker_threads();
 	
@@ -0,0 +1,125 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Test tina_current() and a custom _TINA_SWAP_HOOK. Build it with TINA_CURRENT. (See CMakeLists.txt or Makefile)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+struct tina;
+static void record_swap(struct tina* from, struct tina* to);
+#define _TINA_SWAP_HOOK(_FROM_, _TO_) record_swap(_FROM_, _TO_)
+
+#define TINA_IMPLEMENTATION
+#include "tina.h"
+
+// Log of the switches passed to the hook.
+static struct {tina* from; tina* to;} SWAPS[16];
+static unsigned SWAP_COUNT;
+
+static void record_swap(tina* from, tina* to){
+	assert(SWAP_COUNT < 16);
+	SWAPS[SWAP_COUNT].from = from, SWAPS[SWAP_COUNT].to = to;
+	SWAP_COUNT++;
+}
+
+static void check_swaps(unsigned count, const tina* const* pairs){
+	assert(SWAP_COUNT == count);
+	for(unsigned i = 0; i < count; i++) assert(SWAPS[i].from == pairs[2*i] && SWAPS[i].to == pairs[2*i + 1]);
+	SWAP_COUNT = 0;
+}
+
+static uintptr_t current_body(tina* coro, uintptr_t value){
+	while(true) tina_yield(coro, tina_current() == coro);
+	return 0;
+}
+
+static void test_resume(void){
+	assert(tina_current() == NULL);
+	tina* coro = tina_init(NULL, 256*1024, current_body, NULL);
+	// Initializing the coroutine switches to it's stack and back without running the body yet.
+	check_swaps(2, (const tina*[]){NULL, coro, coro, NULL});
+	assert(tina_current() == NULL);
+	
+	assert(tina_resume(coro, 0));
+	check_swaps(2, (const tina*[]){NULL, coro, coro, NULL});
+	assert(tina_current() == NULL);
+	
+	free(coro->buffer);
+	puts("test_resume() success");
+}
+
+static tina* INNER;
+
+static uintptr_t outer_body(tina* coro, uintptr_t value){
+	// Resuming a coroutine from another one restores the outer one as current once it yields.
+	tina_resume(INNER, 0);
+	tina_yield(coro, tina_current() == coro);
+	return 0;
+}
+
+static void test_nested(void){
+	INNER = tina_init(NULL, 256*1024, current_body, NULL);
+	tina* outer = tina_init(NULL, 256*1024, outer_body, NULL);
+	SWAP_COUNT = 0;
+	
+	assert(tina_resume(outer, 0));
+	assert(tina_current() == NULL);
+	// NULL stands for whichever stack called tina_resume(), so the nested switches don't name 'outer'.
+	check_swaps(4, (const tina*[]){NULL, outer, NULL, INNER, INNER, NULL, outer, NULL});
+	
+	free(INNER->buffer);
+	free(outer->buffer);
+	puts("test_nested() success");
+}
+
+static tina MAIN_CORO;
+static tina* SYMMETRIC[2];
+
+static uintptr_t symmetric_body(tina* coro, uintptr_t value){
+	assert(tina_current() == coro);
+	// Pass control to the other coroutine, and the second one back to the thread.
+	tina_swap(coro, coro == SYMMETRIC[0] ? SYMMETRIC[1] : &MAIN_CORO, 0);
+	abort();
+}
+
+static void test_symmetric(void){
+	MAIN_CORO = TINA_EMPTY;
+	for(unsigned i = 0; i < 2; i++) SYMMETRIC[i] = tina_init(NULL, 256*1024, symmetric_body, NULL);
+	SWAP_COUNT = 0;
+	
+	// The empty coroutine standing in for the thread's stack is passed to the hook as NULL.
+	tina_swap(&MAIN_CORO, SYMMETRIC[0], 0);
+	assert(tina_current() == NULL);
+	check_swaps(3, (const tina*[]){NULL, SYMMETRIC[0], SYMMETRIC[0], SYMMETRIC[1], SYMMETRIC[1], NULL});
+	
+	for(unsigned i = 0; i < 2; i++) free(SYMMETRIC[i]->buffer);
+	puts("test_symmetric() success");
+}
+
+int main(int argc, const char *argv[]){
+	test_resume();
+	test_nested();
+	test_symmetric();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Check that debuggers and profilers can unwind out of a coroutine into the thread that resumed it.
+// Build it with TINA_LINK_FRAMES. (See CMakeLists.txt or Makefile)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#define TINA_IMPLEMENTATION
+#include "tina.h"
+
+#if defined(__GLIBC__) && _TINA_BASE_FRAME
+#include <execinfo.h>
+
+// Return address in main() for the call that resumes the coroutine. Unwinding from the coroutine should reach it.
+static void* RESUMER_RETURN;
+
+static bool unwinds_to_resumer(void){
+	void* frames[64];
+	int count = backtrace(frames, 64);
+	for(int i = 0; i < count; i++){
+		if(frames[i] == RESUMER_RETURN) return true;
+	}
+	return false;
+}
+
+static uintptr_t coro_body(tina* coro, uintptr_t value){
+	// Check the first resume, and again after yielding since the frames are relinked each time.
+	for(unsigned i = 0; i < 3; i++) tina_yield(coro, unwinds_to_resumer());
+	return unwinds_to_resumer();
+}
+
+__attribute__((noinline)) static uintptr_t resume(tina* coro){
+	RESUMER_RETURN = __builtin_return_address(0);
+	uintptr_t value = tina_resume(coro, 0);
+	// Keep the call from becoming a tail call.
+	__asm__ __volatile__("" ::: "memory");
+	return value;
+}
+
+int main(int argc, const char *argv[]){
+	tina* coro = tina_init(NULL, 256*1024, coro_body, NULL);
+	while(!coro->completed){
+		uintptr_t linked = resume(coro);
+		assert(linked);
+	}
+	free(coro->buffer);
+	
+	puts("test_link_frames() success");
+	return EXIT_SUCCESS;
+}
+#else
+int main(int argc, const char *argv[]){
+	puts("test_link_frames() skipped, needs backtrace() and a backend with base frames");
+	return EXIT_SUCCESS;
+}
+#endif
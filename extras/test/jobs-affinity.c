@@ -0,0 +1,104 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Benchmark the worker pool's affinity policies with cache heavy jobs.
+// Each job hammers a scratch buffer owned by the worker running it. If the OS migrates a worker to another core,
+// the buffer has to be pulled into that core's cache again. Pinning keeps it warm.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+// 256 KB per worker, about the size of an L2 cache.
+#define SCRATCH_WORDS (64*1024)
+static uint32_t SCRATCH[TINA_MAX_WORKERS][SCRATCH_WORDS];
+
+#define JOB_COUNT 20000
+#define JOB_STEPS 8192
+
+static void scratch_job(tina_job* job){
+	uint32_t* scratch = SCRATCH[tina_worker_index(tina_job_get_scheduler(job))];
+	uint32_t idx = (uint32_t)tina_job_get_description(job)->user_idx;
+	
+	// Random walk so the prefetcher can't help.
+	for(unsigned i = 0; i < JOB_STEPS; i++){
+		idx = (idx*1103515245u + 12345u) & (SCRATCH_WORDS - 1);
+		scratch[idx] += i;
+	}
+}
+
+static void root_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	tina_group group = {0};
+	
+	for(unsigned i = 0; i < JOB_COUNT; i++){
+		tina_scheduler_enqueue(sched, NULL, scratch_job, NULL, i, QUEUE_WORK, &group);
+		// Don't overflow the job pool.
+		if(i % 512 == 511) tina_job_wait(job, &group, 256);
+	}
+	
+	tina_job_wait(job, &group, 0);
+	tina_scheduler_interrupt(sched, QUEUE_MAIN);
+}
+
+static double seconds(void){
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static void run(const char* label, tina_affinity affinity){
+	// Use a new scheduler each time so worker indexes start over.
+	tina_scheduler* sched = tina_scheduler_new(1024, _QUEUE_COUNT, 64, 64*1024);
+	tina_workers* workers = tina_workers_start(sched, QUEUE_WORK, 0, affinity, "tina-bench");
+	
+	double start = seconds();
+	tina_scheduler_enqueue(sched, NULL, root_job, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(sched, QUEUE_MAIN, TINA_RUN_LOOP);
+	double elapsed = seconds() - start;
+	
+	unsigned count = tina_workers_count(workers);
+	printf("%-9s workers: %3u, %7.1f ms, %6.0fK jobs/sec, cpus:", label, count, 1e3*elapsed, JOB_COUNT/elapsed/1e3);
+	for(unsigned i = 0; i < count && i < 16; i++) printf(" %d", tina_workers_cpu(workers, i));
+	puts(count > 16 ? " ..." : "");
+	
+	tina_workers_stop(workers);
+	tina_scheduler_free(sched);
+}
+
+int main(int argc, const char *argv[]){
+	run("none", TINA_AFFINITY_NONE);
+	run("compact", TINA_AFFINITY_COMPACT);
+	run("scatter", TINA_AFFINITY_SCATTER);
+	run("physical", TINA_AFFINITY_PHYSICAL);
+	return EXIT_SUCCESS;
+}
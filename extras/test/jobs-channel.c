@@ -0,0 +1,135 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Measure tina_channel throughput between producer and consumer jobs spread across the worker threads.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+#define CAPACITY 1024
+#define MAX_BATCH 256
+#define FIBERS 128
+
+static tina_channel* CHAN;
+static size_t MESSAGES = 1 << 24;
+static unsigned PRODUCERS, CONSUMERS, BATCH;
+static uint64_t RECEIVED, SUM;
+static mtx_t LOCK;
+
+static void producer_job(tina_job* job){
+	unsigned idx = tina_job_get_description(job)->user_idx;
+	size_t begin = MESSAGES*idx/PRODUCERS, end = MESSAGES*(idx + 1)/PRODUCERS;
+	uint64_t values[MAX_BATCH];
+	for(size_t i = begin; i < end; i += BATCH){
+		size_t count = end - i < BATCH ? end - i : BATCH;
+		for(size_t j = 0; j < count; j++) values[j] = i + j;
+		tina_channel_send(job, CHAN, values, count);
+	}
+}
+
+static void consumer_job(tina_job* job){
+	uint64_t values[MAX_BATCH], received = 0, sum = 0;
+	size_t count;
+	while((count = tina_channel_recv(job, CHAN, values, BATCH))){
+		for(size_t i = 0; i < count; i++) sum += values[i];
+		received += count;
+	}
+	
+	mtx_lock(&LOCK);
+	RECEIVED += received, SUM += sum;
+	mtx_unlock(&LOCK);
+}
+
+static void root_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	tina_group producers = {0}, consumers = {0};
+	for(unsigned i = 0; i < CONSUMERS; i++) tina_scheduler_enqueue(sched, NULL, consumer_job, NULL, i, QUEUE_WORK, &consumers);
+	for(unsigned i = 0; i < PRODUCERS; i++) tina_scheduler_enqueue(sched, NULL, producer_job, NULL, i, QUEUE_WORK, &producers);
+	
+	// Consumers run until the channel is closed and drained.
+	tina_job_wait(job, &producers, 0);
+	tina_channel_close(sched, CHAN);
+	tina_job_wait(job, &consumers, 0);
+	tina_scheduler_interrupt(sched, QUEUE_MAIN);
+}
+
+static double seconds(void){
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static void run(tina_scheduler* sched, unsigned producers, unsigned consumers, unsigned batch){
+	// Every producer and consumer keeps it's fiber until the run ends, and the root job needs one too.
+	unsigned max_jobs = (FIBERS - 1)/2;
+	if(producers > max_jobs) producers = max_jobs;
+	if(consumers > max_jobs) consumers = max_jobs;
+	
+	PRODUCERS = producers, CONSUMERS = consumers, BATCH = batch;
+	RECEIVED = SUM = 0;
+	CHAN = tina_channel_new(sizeof(uint64_t), CAPACITY);
+	
+	double start = seconds();
+	tina_scheduler_enqueue(sched, NULL, root_job, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(sched, QUEUE_MAIN, TINA_RUN_LOOP);
+	double elapsed = seconds() - start;
+	
+	assert(RECEIVED == MESSAGES);
+	assert(SUM == (uint64_t)MESSAGES*(MESSAGES - 1)/2);
+	printf("%3u producers, %3u consumers, batch: %3u, %7.1f ms, %6.1fM msgs/sec\n", producers, consumers, batch, 1e3*elapsed, MESSAGES/elapsed/1e6);
+	
+	tina_channel_free(CHAN);
+}
+
+int main(int argc, const char *argv[]){
+	if(argc > 1) MESSAGES = strtoull(argv[1], NULL, 0);
+	mtx_init(&LOCK, mtx_plain);
+	
+	tina_scheduler* sched = tina_scheduler_new(1024, _QUEUE_COUNT, FIBERS, 64*1024);
+	tina_scheduler_queue_priority(sched, QUEUE_MAIN, QUEUE_WORK);
+	tina_workers* workers = tina_workers_start(sched, QUEUE_WORK, 0, TINA_AFFINITY_NONE, "tina-bench");
+	unsigned threads = tina_workers_count(workers) + 1;
+	printf("%u messages, %u threads\n", (unsigned)MESSAGES, threads);
+	
+	run(sched, 1, 1, 1);
+	run(sched, 1, 1, 64);
+	run(sched, threads, threads, 1);
+	run(sched, threads, threads, 64);
+	run(sched, 4*threads, 4*threads, 64);
+	
+	tina_workers_stop(workers);
+	tina_scheduler_free(sched);
+	mtx_destroy(&LOCK);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Test futures, group continuations and reusable job graphs.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+tina_scheduler* SCHED;
+
+static void fulfill_job(tina_job* job){
+	tina_future* future = tina_job_get_description(job)->user_data;
+	// Make the awaiting job catch up first.
+	tina_job_yield(job);
+	tina_future_fulfill(tina_job_get_scheduler(job), future, 10*tina_job_get_description(job)->user_idx);
+}
+
+static void test_futures(tina_job* job){
+	tina_future futures[4] = {0};
+	tina_future* ptrs[4] = {&futures[0], &futures[1], &futures[2], &futures[3]};
+	
+	// Wait for the values to be produced on the worker thread.
+	tina_future all = {0};
+	for(unsigned i = 0; i < 4; i++) tina_scheduler_enqueue(SCHED, NULL, fulfill_job, &futures[i], i, QUEUE_WORK, NULL);
+	tina_future_when_all(SCHED, &all, ptrs, 4, QUEUE_WORK);
+	assert(tina_future_await(job, &futures[3]) == 30);
+	assert(tina_future_await(job, &all) == 4);
+	for(unsigned i = 0; i < 4; i++) assert(tina_future_ready(&futures[i]) && tina_future_await(job, &futures[i]) == 10*i);
+	
+	// Already fulfilled inputs resolve immediately.
+	tina_future all_done = {0};
+	tina_future_when_all(SCHED, &all_done, ptrs, 4, QUEUE_WORK);
+	assert(tina_future_ready(&all_done));
+	
+	// The first one fulfilled wins. The others still run their continuations later, so 'any' needs to outlive the test.
+	static tina_future pending[3], any;
+	tina_future* pending_ptrs[3] = {&pending[0], &pending[1], &pending[2]};
+	tina_future_when_any(SCHED, &any, pending_ptrs, 3, QUEUE_WORK);
+	assert(!tina_future_ready(&any));
+	tina_future_fulfill(SCHED, &pending[2], 0);
+	assert(tina_future_await(job, &any) == 2);
+	tina_future_fulfill(SCHED, &pending[0], 0);
+	tina_future_fulfill(SCHED, &pending[1], 0);
+	
+	puts("test_futures() success");
+}
+
+static void run_tests(tina_job* job){
+	test_futures(job);
+	tina_scheduler_interrupt(SCHED, QUEUE_MAIN);
+}
+
+typedef struct {
+	// Order the nodes ran in during the current launch.
+	unsigned order[5], count;
+} graph_ctx;
+
+static void graph_node(tina_job* job){
+	graph_ctx* ctx = tina_job_get_description(job)->user_data;
+	unsigned idx = tina_job_get_description(job)->user_idx;
+	// Waiting on something unrelated doesn't hold up anything but the node's own successors.
+	if(idx == 1) tina_job_yield(job);
+	ctx->order[idx] = ctx->count++;
+}
+
+// Called from the main thread outside of any job.
+static void test_graph(void){
+	graph_ctx ctx = {{0}, 0};
+	tina_graph* graph = tina_graph_new(5, 5);
+	
+	// A diamond with a tail: 0 -> (1, 2) -> 3 -> 4
+	for(unsigned i = 0; i < 5; i++){
+		tina_job_description desc = {.name = "GraphNode", .func = graph_node, .user_data = &ctx, .user_idx = i, .queue_idx = QUEUE_WORK};
+		assert(tina_graph_add_node(graph, &desc) == i);
+	}
+	tina_graph_add_edge(graph, 0, 1);
+	tina_graph_add_edge(graph, 0, 2);
+	tina_graph_add_edge(graph, 1, 3);
+	tina_graph_add_edge(graph, 2, 3);
+	tina_graph_add_edge(graph, 3, 4);
+	
+	// Launch it a few times to check that it resets.
+	tina_group group = {0};
+	for(unsigned launch = 0; launch < 3; launch++){
+		ctx.count = 0;
+		tina_graph_launch(SCHED, graph, &group);
+		assert(tina_group_wait_blocking(SCHED, &group, 0, TINA_NO_QUEUE) == 0);
+		
+		assert(ctx.count == 5);
+		assert(ctx.order[0] == 0);
+		assert(ctx.order[1] < ctx.order[3] && ctx.order[2] < ctx.order[3]);
+		assert(ctx.order[4] == 4);
+	}
+	
+	tina_graph_free(graph);
+	puts("test_graph() success");
+}
+
+typedef struct {
+	tina_group done;
+	unsigned work_count, seen_count, then_count;
+} then_ctx;
+
+static void then_work(tina_job* job){
+	then_ctx* ctx = tina_job_get_description(job)->user_data;
+	ctx->work_count++;
+}
+
+static void then_job(tina_job* job){
+	then_ctx* ctx = tina_job_get_description(job)->user_data;
+	ctx->seen_count = ctx->work_count;
+	ctx->then_count++;
+	tina_group_decrement(tina_job_get_scheduler(job), &ctx->done, 1);
+}
+
+// Called from the main thread outside of any job.
+static void test_group_then(void){
+	tina_group work = {0};
+	then_ctx ctx = {.then_count = 0};
+	tina_job_description then_desc = {.name = "Then", .func = then_job, .user_data = &ctx, .queue_idx = QUEUE_WORK};
+	
+	// Runs once half the work is done. Only this thread runs the main queue, and it runs it in order, so it sees exactly half.
+	tina_job_description main_desc = then_desc;
+	main_desc.queue_idx = QUEUE_MAIN;
+	for(unsigned i = 0; i < 10; i++) tina_scheduler_enqueue(SCHED, NULL, then_work, &ctx, i, QUEUE_MAIN, &work);
+	tina_group_increment(SCHED, &ctx.done, 1, 0);
+	tina_group_then(SCHED, &work, 5, &main_desc);
+	tina_group_wait_blocking(SCHED, &ctx.done, 0, QUEUE_MAIN);
+	assert(ctx.seen_count == 5 && ctx.then_count == 1);
+	tina_group_wait_blocking(SCHED, &work, 0, QUEUE_MAIN);
+	
+	// Already done, so it's enqueued immediately.
+	tina_group_increment(SCHED, &ctx.done, 1, 0);
+	tina_group_then(SCHED, &work, 0, &then_desc);
+	tina_group_wait_blocking(SCHED, &ctx.done, 0, TINA_NO_QUEUE);
+	assert(ctx.then_count == 2);
+	
+	// Continuations don't hold fibers while waiting, so there can be more of them than fibers.
+	tina_group_increment(SCHED, &work, 1, 0);
+	tina_group_increment(SCHED, &ctx.done, 100, 0);
+	for(unsigned i = 0; i < 100; i++) tina_group_then(SCHED, &work, 0, &then_desc);
+	tina_group_decrement(SCHED, &work, 1);
+	tina_group_wait_blocking(SCHED, &ctx.done, 0, TINA_NO_QUEUE);
+	assert(ctx.then_count == 102);
+	
+	puts("test_group_then() success");
+}
+
+int main(int argc, const char *argv[]){
+	SCHED = tina_scheduler_new(1024, _QUEUE_COUNT, 65, 64*1024);
+	common_start_worker_threads(1, SCHED, QUEUE_WORK);
+	
+	tina_scheduler_enqueue(SCHED, NULL, run_tests, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_LOOP);
+	test_graph();
+	test_group_then();
+	
+	tina_scheduler_interrupt(SCHED, QUEUE_WORK);
+	common_destroy_worker_threads();
+	
+	return EXIT_SUCCESS;
+}
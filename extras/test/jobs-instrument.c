@@ -0,0 +1,201 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Check the output of the optional instrumentation. Build it with the TINA_JOBS_* defines for the features to test.
+// (See CMakeLists.txt or Makefile) Sections for features that aren't compiled in are skipped.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+#define CHILD_COUNT 10
+
+static tina_scheduler* SCHED;
+
+static void child_job(tina_job* job){
+	tina_job_yield(job);
+}
+
+// Yields once, then waits for it's children. Each child yields once before completing.
+static void parent_job(tina_job* job){
+	tina_group group = {0};
+	for(unsigned i = 0; i < CHILD_COUNT; i++) tina_scheduler_enqueue(SCHED, "Child", child_job, NULL, i, 0, &group);
+	tina_job_yield(job);
+	tina_job_wait(job, &group, 0);
+}
+
+static char* read_file(const char* filename){
+	FILE* file = fopen(filename, "rb");
+	assert(file);
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	
+	char* str = malloc(size + 1);
+	size_t read = fread(str, 1, size, file);
+	assert(read == (size_t)size);
+	str[read] = 0;
+	fclose(file);
+	return str;
+}
+
+static unsigned count_substr(const char* str, const char* substr){
+	unsigned count = 0;
+	for(str = strstr(str, substr); str; str = strstr(str + 1, substr)) count++;
+	return count;
+}
+
+#ifdef TINA_JOBS_TRACE
+static void test_trace(void){
+	const char* filename = "jobs-instrument-trace.json";
+	assert(tina_scheduler_trace_flush(SCHED, filename));
+	char* trace = read_file(filename);
+	
+	// The parent yields, waits and completes. The children yield and complete.
+	assert(count_substr(trace, "\"ph\": \"X\"") == 3 + 2*CHILD_COUNT);
+	assert(count_substr(trace, "{\"name\": \"Parent\", \"cat\": \"wait\"") == 1);
+	assert(count_substr(trace, "{\"name\": \"Parent\", \"cat\": \"yield\"") == 1);
+	assert(count_substr(trace, "{\"name\": \"Child\", \"cat\": \"yield\"") == CHILD_COUNT);
+	assert(count_substr(trace, "\"cat\": \"completed\"") == 1 + CHILD_COUNT);
+	assert(count_substr(trace, "\"name\": \"Worker 0\"") == 1);
+	free(trace);
+	
+	// Flushing clears the events.
+	assert(tina_scheduler_trace_flush(SCHED, filename));
+	trace = read_file(filename);
+	assert(count_substr(trace, "\"ph\": \"X\"") == 0);
+	free(trace);
+	
+	remove(filename);
+	puts("test_trace() success");
+}
+#endif
+
+#ifdef TINA_JOBS_STATS
+static void test_stats(void){
+	static tina_stats stats;
+	unsigned queue_length;
+	tina_scheduler_stats(SCHED, &stats, &queue_length);
+	
+	// Everything ran on this thread.
+	assert(stats.workers == 1 && stats.workers_parked == 0);
+	assert(stats.jobs_queued == 0 && queue_length == 0 && stats.jobs_waiting == 0);
+	assert(stats.jobs_free == stats.job_count && stats.fibers_free == stats.fiber_count);
+	assert(stats.jobs_high_water == 1 + CHILD_COUNT && stats.fibers_high_water == 1 + CHILD_COUNT);
+	
+	assert(stats.worker[0].jobs_run == 1 + CHILD_COUNT);
+	assert(stats.worker[0].yields == 1 + CHILD_COUNT);
+	assert(stats.worker[0].waits == 1);
+	assert(stats.worker[0].queue_switches == 0);
+	assert(stats.worker[0].lock_acquisitions > 0 && stats.worker[0].lock_contended == 0);
+	assert(stats.total.jobs_run == stats.worker[0].jobs_run && stats.total.lock_acquisitions >= stats.worker[0].lock_acquisitions);
+	
+	puts("test_stats() success");
+}
+#endif
+
+#ifdef TINA_JOBS_NAME_STATS
+static const tina_name_stats* find_name_stats(const tina_name_stats* stats, unsigned count, const char* name){
+	for(unsigned i = 0; i < count; i++) if(strcmp(stats[i].name, name) == 0) return &stats[i];
+	return NULL;
+}
+
+static void test_name_stats(void){
+	tina_name_stats stats[8];
+	unsigned count = tina_scheduler_name_stats(SCHED, stats, 8, true);
+	assert(count == 2);
+	
+	const tina_name_stats* parent = find_name_stats(stats, count, "Parent");
+	assert(parent && parent->run_count == 1 && parent->suspend_count == 2);
+	assert(parent->wall_time >= parent->cpu_time);
+	
+	const tina_name_stats* child = find_name_stats(stats, count, "Child");
+	assert(child && child->run_count == CHILD_COUNT && child->suspend_count == CHILD_COUNT);
+	assert(child->wall_time >= child->cpu_time);
+	
+	// Resetting keeps the names, but clears the counters.
+	count = tina_scheduler_name_stats(SCHED, stats, 8, false);
+	assert(count == 2);
+	for(unsigned i = 0; i < count; i++) assert(stats[i].run_count == 0 && stats[i].cpu_time == 0 && stats[i].wall_time == 0);
+	
+	puts("test_name_stats() success");
+}
+#endif
+
+#ifdef TINA_JOBS_OFFCPU
+static void test_offcpu(void){
+	const char* filename = "jobs-instrument-offcpu.txt";
+	assert(tina_scheduler_offcpu_flush(SCHED, filename));
+	char* folded = read_file(filename);
+	
+	// Lines are "name;frame;frame... nanoseconds". Each job suspends once in tina_job_yield(), and the parent waits too.
+	unsigned parent_sites = 0, child_sites = 0;
+	for(char* line = strtok(folded, "\n"); line; line = strtok(NULL, "\n")){
+		char* value = strrchr(line, ' ');
+		assert(value && strtoull(value + 1, NULL, 10) > 0);
+		
+		if(strncmp(line, "Parent", 6) == 0 && (line[6] == ';' || line[6] == ' ')) parent_sites++;
+		else if(strncmp(line, "Child", 5) == 0 && (line[5] == ';' || line[5] == ' ')) child_sites++;
+		else assert(!"Unexpected off-CPU line.");
+	}
+	// Zero frame stacks still count. They just can't tell the yield and wait apart.
+	assert(1 <= parent_sites && parent_sites <= 2);
+	assert(child_sites == 1);
+	free(folded);
+	
+	// Flushing clears the sites.
+	assert(tina_scheduler_offcpu_flush(SCHED, filename));
+	folded = read_file(filename);
+	assert(folded[0] == 0);
+	free(folded);
+	
+	remove(filename);
+	puts("test_offcpu() success");
+}
+#endif
+
+int main(int argc, const char *argv[]){
+	SCHED = tina_scheduler_new(64, 1, 16, 64*1024);
+	tina_scheduler_enqueue(SCHED, "Parent", parent_job, NULL, 0, 0, NULL);
+	tina_scheduler_run(SCHED, 0, TINA_RUN_FLUSH);
+	
+#ifdef TINA_JOBS_TRACE
+	test_trace();
+#endif
+#ifdef TINA_JOBS_STATS
+	test_stats();
+#endif
+#ifdef TINA_JOBS_NAME_STATS
+	test_name_stats();
+#endif
+#ifdef TINA_JOBS_OFFCPU
+	test_offcpu();
+#endif
+	
+	tina_scheduler_free(SCHED);
+	return EXIT_SUCCESS;
+}
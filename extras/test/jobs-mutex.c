@@ -0,0 +1,134 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Benchmark a contended tina_job_mutex against an OS mutex (pthreads via tinycthread) taken inside jobs,
+// and against switching to a worker's private queue to serialize the critical section.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+typedef enum {
+	MODE_OS_MUTEX,
+	MODE_JOB_MUTEX,
+	MODE_SERIAL_QUEUE,
+} lock_mode;
+
+#define JOB_COUNT 64
+#define ITERATIONS 20000
+
+static lock_mode MODE;
+static mtx_t OS_MUTEX;
+static tina_job_mutex JOB_MUTEX;
+
+// Shared state updated inside the critical section.
+static uint64_t SHARED[8];
+static unsigned LOCK_COUNT;
+
+static uint64_t work(uint64_t x, unsigned steps){
+	for(unsigned i = 0; i < steps; i++) x = x*6364136223846793005u + 1442695040888963407u;
+	return x;
+}
+
+static void critical_section(uint64_t x){
+	for(unsigned i = 0; i < 8; i++) SHARED[i] += x >> (8*i) & 0xFF;
+	LOCK_COUNT++;
+}
+
+static void contend_job(tina_job* job){
+	uint64_t x = tina_job_get_description(job)->user_idx;
+	for(unsigned i = 0; i < ITERATIONS; i++){
+		x = work(x, 64);
+		switch(MODE){
+			case MODE_OS_MUTEX: {
+				mtx_lock(&OS_MUTEX);
+				critical_section(x);
+				mtx_unlock(&OS_MUTEX);
+			} break;
+			case MODE_JOB_MUTEX: {
+				tina_job_mutex_lock(job, &JOB_MUTEX);
+				critical_section(x);
+				tina_job_mutex_unlock(job, &JOB_MUTEX);
+			} break;
+			case MODE_SERIAL_QUEUE: {
+				unsigned queue = tina_job_switch_queue(job, TINA_WORKER_QUEUE(0));
+				critical_section(x);
+				tina_job_switch_queue(job, queue);
+			} break;
+		}
+	}
+}
+
+static void root_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	tina_group group = {0};
+	for(unsigned i = 0; i < JOB_COUNT; i++) tina_scheduler_enqueue(sched, NULL, contend_job, NULL, i, QUEUE_WORK, &group);
+	tina_job_wait(job, &group, 0);
+	tina_scheduler_interrupt(sched, QUEUE_MAIN);
+}
+
+static double seconds(void){
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static void run(const char* label, lock_mode mode){
+	MODE = mode;
+	LOCK_COUNT = 0;
+	
+	tina_scheduler* sched = tina_scheduler_new(1024, _QUEUE_COUNT, 128, 64*1024);
+	tina_scheduler_queue_priority(sched, QUEUE_MAIN, QUEUE_WORK);
+	tina_workers* workers = tina_workers_start(sched, QUEUE_WORK, 0, TINA_AFFINITY_NONE, "tina-bench");
+	
+	double start = seconds();
+	tina_scheduler_enqueue(sched, NULL, root_job, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(sched, QUEUE_MAIN, TINA_RUN_LOOP);
+	double elapsed = seconds() - start;
+	
+	unsigned locks = JOB_COUNT*ITERATIONS;
+	assert(LOCK_COUNT == locks);
+	printf("%-12s workers: %3u, %7.1f ms, %6.0fK locks/sec\n", label, tina_workers_count(workers) + 1, 1e3*elapsed, locks/elapsed/1e3);
+	
+	tina_workers_stop(workers);
+	tina_scheduler_free(sched);
+}
+
+int main(int argc, const char *argv[]){
+	mtx_init(&OS_MUTEX, mtx_plain);
+	run("os mutex", MODE_OS_MUTEX);
+	run("job mutex", MODE_JOB_MUTEX);
+	run("serial queue", MODE_SERIAL_QUEUE);
+	mtx_destroy(&OS_MUTEX);
+	return EXIT_SUCCESS;
+}
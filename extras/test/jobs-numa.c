@@ -0,0 +1,155 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Test NUMA scheduling against the fake dual socket topology in test/fake-sysfs, so it runs on single node machines too.
+// Build it with _TINA_SYSFS_CPU and _TINA_SYSFS_NODE pointing there. (See CMakeLists.txt or Makefile)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#if __linux__
+	#include <sys/prctl.h>
+#endif
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+#define NODE_COUNT 2
+#define JOB_COUNT 10000
+
+static tina_scheduler* SCHED;
+
+typedef struct {
+	unsigned order[2], count;
+} order_ctx;
+
+static void record_job(tina_job* job){
+	order_ctx* ctx = tina_job_get_description(job)->user_data;
+	ctx->order[ctx->count++] = (unsigned)tina_job_get_description(job)->user_idx;
+}
+
+static int enqueue_remote(void* data){
+	tina_worker_set_node(1);
+	tina_scheduler_enqueue(SCHED, "remote", record_job, data, 1, QUEUE_MAIN, NULL);
+	return 0;
+}
+
+static void test_local_first(void){
+	order_ctx ctx = {{0}, 0};
+	
+	// Queue a job from a thread on node 1 first.
+	thrd_t thread;
+	thrd_create(&thread, enqueue_remote, &ctx);
+	thrd_join(thread, NULL);
+	tina_scheduler_enqueue(SCHED, "local", record_job, &ctx, 0, QUEUE_MAIN, NULL);
+	
+	// The main thread is on node 0, so it should run it's own node's job first.
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_SINGLE);
+	assert(tina_worker_node() == 0);
+	assert(ctx.count == 1 && ctx.order[0] == 0);
+	
+	// Then steal the other one once it's own node is empty.
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_SINGLE);
+	assert(ctx.count == 2 && ctx.order[1] == 1);
+	
+	puts("test_local_first() success");
+}
+
+static unsigned WORKER_NODE[TINA_MAX_WORKERS], WORKER_RUNS[TINA_MAX_WORKERS];
+static char WORKER_NAME[TINA_MAX_WORKERS][16];
+
+static void node_job(tina_job* job){
+	unsigned idx = tina_worker_index(SCHED);
+	WORKER_NODE[idx] = tina_worker_node();
+	WORKER_RUNS[idx]++;
+#if __linux__
+	prctl(PR_GET_NAME, WORKER_NAME[idx], 0, 0, 0);
+#endif
+}
+
+static void root_job(tina_job* job){
+	tina_group group = {0};
+	for(unsigned i = 0; i < JOB_COUNT; i++){
+		tina_scheduler_enqueue(SCHED, "node", node_job, NULL, i, QUEUE_WORK, &group);
+		// Don't overflow the job pool.
+		if(i % 512 == 511) tina_job_wait(job, &group, 256);
+	}
+	
+	tina_job_wait(job, &group, 0);
+	tina_scheduler_interrupt(SCHED, QUEUE_MAIN);
+}
+
+static void test_workers(void){
+	// Use the default name to check that it isn't truncated.
+	tina_workers* workers = tina_workers_start(SCHED, QUEUE_WORK, 0, TINA_AFFINITY_COMPACT, NULL);
+	// Compact pinning fills node 0's CPUs before node 1's.
+	assert(tina_workers_count(workers) == 4);
+	for(unsigned i = 0; i < 4; i++) assert(tina_workers_cpu(workers, i) == (int)i);
+	
+	tina_scheduler_enqueue(SCHED, "root", root_job, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_LOOP);
+	tina_workers_stop(workers);
+	
+	unsigned node_runs[NODE_COUNT] = {0};
+	for(unsigned i = 0; i < TINA_MAX_WORKERS; i++){
+		assert(WORKER_NODE[i] < NODE_COUNT);
+		node_runs[WORKER_NODE[i]] += WORKER_RUNS[i];
+#if __linux__
+		// Only the pool's threads run QUEUE_WORK, and they are named with their index in the pool.
+		if(WORKER_RUNS[i]){
+			assert(strncmp(WORKER_NAME[i], "tina-worker", 11) == 0);
+			assert(strlen(WORKER_NAME[i]) == 12 && WORKER_NAME[i][11] >= '0' && WORKER_NAME[i][11] < '4');
+		}
+#endif
+	}
+	assert(node_runs[0] + node_runs[1] == JOB_COUNT);
+	printf("jobs run on node 0: %u, node 1: %u\n", node_runs[0], node_runs[1]);
+	
+	// Every job and fiber should have made it back to it's pool.
+	static tina_stats stats;
+	tina_scheduler_stats(SCHED, &stats, NULL);
+	assert(stats.jobs_free == stats.job_count && stats.fibers_free == stats.fiber_count);
+	assert(stats.jobs_queued == 0);
+	
+	puts("test_workers() success");
+}
+
+int main(int argc, const char *argv[]){
+	assert(tina_numa_node_count() == NODE_COUNT);
+	SCHED = tina_scheduler_new_numa(1024, _QUEUE_COUNT, 64, 64*1024, NODE_COUNT);
+	tina_worker_set_node(0);
+	
+	test_local_first();
+	test_workers();
+	
+	tina_scheduler_free(SCHED);
+	return EXIT_SUCCESS;
+}
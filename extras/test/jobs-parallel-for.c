@@ -0,0 +1,108 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Test that tina_parallel_for() visits every element once, and splits the range when another thread is idle.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+tina_scheduler* SCHED;
+
+#define FOR_COUNT 100000
+#define FOR_GRAIN 100
+
+typedef struct {
+	uint8_t visits[FOR_COUNT];
+	unsigned chunks;
+	// Distinct jobs that ran chunks. More than one means the range was split.
+	tina_job* jobs[FOR_COUNT/FOR_GRAIN];
+	unsigned job_count;
+	mtx_t lock;
+} for_ctx;
+
+static void for_body(tina_job* job, void* ctx, size_t begin, size_t end){
+	for_ctx* fctx = ctx;
+	assert(begin < end && end - begin <= FOR_GRAIN && begin % FOR_GRAIN == 0);
+	for(size_t i = begin; i < end; i++) fctx->visits[i]++;
+	// Give the other thread a chance to go idle, even with a single CPU.
+	thrd_yield();
+	
+	mtx_lock(&fctx->lock);
+	fctx->chunks++;
+	unsigned i = 0;
+	while(i < fctx->job_count && fctx->jobs[i] != job) i++;
+	if(i == fctx->job_count) fctx->jobs[fctx->job_count++] = job;
+	mtx_unlock(&fctx->lock);
+}
+
+// Called from the main thread outside of any job.
+static void test_parallel_for(void){
+	static for_ctx ctx;
+	mtx_init(&ctx.lock, mtx_plain);
+	tina_group group = {0};
+	
+	// Run it on the worker thread alone, and then again while this thread helps so the job can split.
+	for(unsigned pass = 0; pass < 2; pass++){
+		memset(ctx.visits, 0, sizeof(ctx.visits));
+		ctx.chunks = ctx.job_count = 0;
+		tina_parallel_for(SCHED, 0, FOR_COUNT, FOR_GRAIN, for_body, &ctx, QUEUE_WORK, &group);
+		tina_group_wait_blocking(SCHED, &group, 0, pass ? QUEUE_WORK : TINA_NO_QUEUE);
+		
+		assert(ctx.chunks == FOR_COUNT/FOR_GRAIN);
+		for(unsigned i = 0; i < FOR_COUNT; i++) assert(ctx.visits[i] == 1);
+		// Nothing is idle to split for when the worker runs it alone. (Split jobs can reuse a finished one's memory, so this undercounts)
+		assert(pass ? ctx.job_count > 1 : ctx.job_count == 1);
+	}
+	
+	// Ranges that don't divide evenly get a short last chunk.
+	memset(ctx.visits, 0, sizeof(ctx.visits));
+	tina_parallel_for(SCHED, 0, FOR_GRAIN + 1, FOR_GRAIN, for_body, &ctx, QUEUE_WORK, &group);
+	tina_group_wait_blocking(SCHED, &group, 0, TINA_NO_QUEUE);
+	assert(ctx.visits[0] == 1 && ctx.visits[FOR_GRAIN] == 1 && ctx.visits[FOR_GRAIN + 1] == 0);
+	
+	mtx_destroy(&ctx.lock);
+	puts("test_parallel_for() success");
+}
+
+int main(int argc, const char *argv[]){
+	SCHED = tina_scheduler_new(1024, _QUEUE_COUNT, 65, 64*1024);
+	common_start_worker_threads(1, SCHED, QUEUE_WORK);
+	
+	test_parallel_for();
+	
+	tina_scheduler_interrupt(SCHED, QUEUE_WORK);
+	common_destroy_worker_threads();
+	
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Benchmark tina_parallel_reduce() and tina_parallel_scan() against single threaded loops using the same functions.
+// Elements are generated from their index, so only the prefix-sum's output uses memory. It's kept mod 256 to fit in a byte each.
+// Pass the element count as the first argument. (default 1e9)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+#define GRAIN (64*1024)
+
+static size_t COUNT = 1000000000;
+static uint8_t* OUTPUT;
+
+static inline uint8_t element(size_t i){
+	uint32_t x = (uint32_t)i*2654435761u;
+	x ^= x >> 15;
+	x *= 0x2c1b3c6du;
+	return (uint8_t)(x >> 24);
+}
+
+static void sum_fold(void* ctx, void* acc, size_t begin, size_t end){
+	uint64_t sum = 0;
+	for(size_t i = begin; i < end; i++) sum += element(i);
+	*(uint64_t*)acc += sum;
+}
+
+static void sum_combine(void* ctx, void* dst, const void* src){
+	*(uint64_t*)dst += *(const uint64_t*)src;
+}
+
+typedef struct {
+	uint64_t bins[256];
+} histogram;
+
+static void histogram_fold(void* ctx, void* acc, size_t begin, size_t end){
+	histogram* hist = acc;
+	for(size_t i = begin; i < end; i++) hist->bins[element(i)]++;
+}
+
+static void histogram_combine(void* ctx, void* dst, const void* src){
+	histogram* a = dst;
+	const histogram* b = src;
+	for(unsigned i = 0; i < 256; i++) a->bins[i] += b->bins[i];
+}
+
+// Inclusive prefix-sum.
+static void prefix_scan(void* ctx, void* acc, size_t begin, size_t end){
+	uint64_t sum = *(uint64_t*)acc;
+	for(size_t i = begin; i < end; i++){
+		sum += element(i);
+		OUTPUT[i] = (uint8_t)sum;
+	}
+	*(uint64_t*)acc = sum;
+}
+
+static uint64_t checksum(void){
+	uint64_t hash = 0;
+	for(size_t i = 0; i < COUNT; i++) hash = hash*31 + OUTPUT[i];
+	return hash;
+}
+
+static double seconds(void){
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static void report(const char* label, double serial, double parallel){
+	printf("%-10s serial: %8.1f ms, parallel: %8.1f ms, speedup: %5.2fx\n", label, 1e3*serial, 1e3*parallel, serial/parallel);
+}
+
+static void root_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	void* scratch = malloc(tina_parallel_scratch_size(sizeof(histogram)));
+	double start;
+	
+	uint64_t zero = 0;
+	tina_reduce_description sum_desc = {.fold = sum_fold, .combine = sum_combine, .scan = prefix_scan, .identity = &zero, .value_size = sizeof(uint64_t)};
+	uint64_t serial_sum = 0, parallel_sum = 0;
+	start = seconds();
+	sum_fold(NULL, &serial_sum, 0, COUNT);
+	double serial = seconds() - start;
+	start = seconds();
+	tina_parallel_reduce(job, &sum_desc, 0, COUNT, GRAIN, QUEUE_WORK, scratch, &parallel_sum);
+	report("sum", serial, seconds() - start);
+	assert(serial_sum == parallel_sum);
+	
+	static const histogram empty = {{0}};
+	tina_reduce_description hist_desc = {.fold = histogram_fold, .combine = histogram_combine, .identity = &empty, .value_size = sizeof(histogram)};
+	static histogram serial_hist, parallel_hist;
+	start = seconds();
+	histogram_fold(NULL, &serial_hist, 0, COUNT);
+	serial = seconds() - start;
+	start = seconds();
+	tina_parallel_reduce(job, &hist_desc, 0, COUNT, GRAIN, QUEUE_WORK, scratch, &parallel_hist);
+	report("histogram", serial, seconds() - start);
+	for(unsigned i = 0; i < 256; i++) assert(serial_hist.bins[i] == parallel_hist.bins[i]);
+	
+	uint64_t serial_total = 0, parallel_total = 0;
+	start = seconds();
+	prefix_scan(NULL, &serial_total, 0, COUNT);
+	serial = seconds() - start;
+	uint64_t serial_checksum = checksum();
+	start = seconds();
+	tina_parallel_scan(job, &sum_desc, 0, COUNT, GRAIN, QUEUE_WORK, scratch, &parallel_total);
+	report("prefix-sum", serial, seconds() - start);
+	assert(serial_total == parallel_total && serial_total == serial_sum);
+	assert(serial_checksum == checksum());
+	
+	free(scratch);
+	tina_scheduler_interrupt(sched, QUEUE_MAIN);
+}
+
+int main(int argc, const char *argv[]){
+	if(argc > 1) COUNT = strtoull(argv[1], NULL, 0);
+	OUTPUT = malloc(COUNT);
+	
+	tina_scheduler* sched = tina_scheduler_new(1024, _QUEUE_COUNT, 64, 64*1024);
+	// Let the main thread help with the work queue while the root job waits.
+	tina_scheduler_queue_priority(sched, QUEUE_MAIN, QUEUE_WORK);
+	common_start_worker_threads(0, sched, QUEUE_WORK);
+	
+	tina_scheduler_enqueue(sched, NULL, root_job, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(sched, QUEUE_MAIN, TINA_RUN_LOOP);
+	puts("Results match.");
+	
+	common_destroy_worker_threads();
+	tina_scheduler_free(sched);
+	free(OUTPUT);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,293 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Test the job mutex, reader-writer lock, semaphore and channels. (See jobs-mutex.c and jobs-channel.c for benchmarks)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+tina_scheduler* SCHED;
+
+// Yield until another job suspends, so the number of waiting jobs is more than 'waiting'.
+static void yield_until_waiting(tina_job* job, unsigned waiting){
+	tina_stats stats;
+	do {
+		tina_job_yield(job);
+		tina_scheduler_stats(SCHED, &stats, NULL);
+	} while(stats.jobs_waiting <= waiting);
+}
+
+static unsigned jobs_waiting(void){
+	tina_stats stats;
+	tina_scheduler_stats(SCHED, &stats, NULL);
+	return stats.jobs_waiting;
+}
+
+typedef struct {
+	tina_job_mutex mutex;
+	unsigned counter;
+} mutex_ctx;
+
+static void mutex_job(tina_job* job){
+	mutex_ctx* ctx = tina_job_get_description(job)->user_data;
+	tina_job_mutex_lock(job, &ctx->mutex);
+	// Suspend while holding the lock. An OS mutex would deadlock the worker thread here.
+	unsigned counter = ctx->counter;
+	tina_job_yield(job);
+	ctx->counter = counter + 1;
+	tina_job_mutex_unlock(job, &ctx->mutex);
+}
+
+static void test_job_mutex(tina_job* job){
+	mutex_ctx ctx = {.counter = 0};
+	tina_group group = {0};
+	// Every job ends up suspended at once, so stay under the fiber count.
+	for(unsigned i = 0; i < 50; i++) tina_scheduler_enqueue(SCHED, NULL, mutex_job, &ctx, i, QUEUE_WORK, &group);
+	tina_job_wait(job, &group, 0);
+	assert(ctx.counter == 50);
+	
+	assert(tina_job_mutex_try_lock(&ctx.mutex));
+	assert(!tina_job_mutex_try_lock(&ctx.mutex));
+	tina_job_mutex_unlock(job, &ctx.mutex);
+	
+	puts("test_job_mutex() success");
+}
+
+typedef struct {
+	tina_job_rwlock rwlock;
+	unsigned a, b, readers, max_readers, reads;
+	mtx_t lock;
+} rwlock_ctx;
+
+static void rwlock_job(tina_job* job){
+	rwlock_ctx* ctx = tina_job_get_description(job)->user_data;
+	if(tina_job_get_description(job)->user_idx % 4 == 0){
+		// Writers suspend halfway through updating the pair.
+		tina_job_rwlock_write_lock(job, &ctx->rwlock);
+		assert(ctx->readers == 0);
+		ctx->a++;
+		tina_job_yield(job);
+		ctx->b++;
+		tina_job_rwlock_write_unlock(job, &ctx->rwlock);
+	} else {
+		tina_job_rwlock_read_lock(job, &ctx->rwlock);
+		mtx_lock(&ctx->lock);
+		if(++ctx->readers > ctx->max_readers) ctx->max_readers = ctx->readers;
+		mtx_unlock(&ctx->lock);
+		// Readers suspend while holding the lock, so other readers can overlap with them.
+		tina_job_yield(job);
+		assert(ctx->a == ctx->b);
+		mtx_lock(&ctx->lock);
+		ctx->readers--, ctx->reads++;
+		mtx_unlock(&ctx->lock);
+		tina_job_rwlock_read_unlock(job, &ctx->rwlock);
+	}
+}
+
+static void test_job_rwlock(tina_job* job){
+	static rwlock_ctx ctx;
+	mtx_init(&ctx.lock, mtx_plain);
+	tina_group group = {0};
+	for(unsigned i = 0; i < 48; i++) tina_scheduler_enqueue(SCHED, NULL, rwlock_job, &ctx, i, QUEUE_WORK, &group);
+	tina_job_wait(job, &group, 0);
+	assert(ctx.a == 12 && ctx.b == 12);
+	assert(ctx.reads == 36 && ctx.readers == 0);
+	assert(ctx.max_readers > 1);
+	
+	// Uncontended locks stay on the fast paths.
+	tina_job_rwlock_read_lock(job, &ctx.rwlock);
+	tina_job_rwlock_read_lock(job, &ctx.rwlock);
+	tina_job_rwlock_read_unlock(job, &ctx.rwlock);
+	tina_job_rwlock_read_unlock(job, &ctx.rwlock);
+	tina_job_rwlock_write_lock(job, &ctx.rwlock);
+	tina_job_rwlock_write_unlock(job, &ctx.rwlock);
+	
+	mtx_destroy(&ctx.lock);
+	puts("test_job_rwlock() success");
+}
+
+typedef struct {
+	tina_job_semaphore sem;
+	unsigned in_use, max_in_use, count;
+	mtx_t lock;
+} semaphore_ctx;
+
+static void semaphore_job(tina_job* job){
+	semaphore_ctx* ctx = tina_job_get_description(job)->user_data;
+	// Mix single and batched acquires.
+	unsigned permits = 1 + tina_job_get_description(job)->user_idx % 2;
+	tina_job_semaphore_acquire(job, &ctx->sem, permits);
+	mtx_lock(&ctx->lock);
+	ctx->in_use += permits;
+	if(ctx->in_use > ctx->max_in_use) ctx->max_in_use = ctx->in_use;
+	mtx_unlock(&ctx->lock);
+	
+	tina_job_yield(job);
+	
+	mtx_lock(&ctx->lock);
+	ctx->in_use -= permits, ctx->count++;
+	mtx_unlock(&ctx->lock);
+	tina_job_semaphore_release(SCHED, &ctx->sem, permits);
+}
+
+static void test_job_semaphore(tina_job* job){
+	semaphore_ctx ctx = {.in_use = 0};
+	mtx_init(&ctx.lock, mtx_plain);
+	tina_job_semaphore_init(&ctx.sem, 3);
+	tina_group group = {0};
+	for(unsigned i = 0; i < 50; i++) tina_scheduler_enqueue(SCHED, NULL, semaphore_job, &ctx, i, QUEUE_WORK, &group);
+	tina_job_wait(job, &group, 0);
+	assert(ctx.count == 50);
+	assert(ctx.in_use == 0 && ctx.max_in_use <= 3 && ctx.max_in_use > 1);
+	
+	assert(tina_job_semaphore_try_acquire(&ctx.sem, 3));
+	assert(!tina_job_semaphore_try_acquire(&ctx.sem, 1));
+	// A waiter is woken once enough permits are released, even one at a time.
+	unsigned waiting = jobs_waiting();
+	tina_scheduler_enqueue(SCHED, NULL, semaphore_job, &ctx, 1, QUEUE_WORK, &group);
+	yield_until_waiting(job, waiting);
+	tina_job_semaphore_release(SCHED, &ctx.sem, 1);
+	assert(!tina_job_semaphore_try_acquire(&ctx.sem, 1));
+	tina_job_semaphore_release(SCHED, &ctx.sem, 2);
+	tina_job_wait(job, &group, 0);
+	assert(ctx.count == 51);
+	assert(tina_job_semaphore_try_acquire(&ctx.sem, 3));
+	
+	mtx_destroy(&ctx.lock);
+	puts("test_job_semaphore() success");
+}
+
+#define CHANNEL_VALUES 1000
+
+typedef struct {
+	tina_channel* chan;
+	uint64_t sum;
+	unsigned received;
+	mtx_t lock;
+} channel_ctx;
+
+static void channel_producer(tina_job* job){
+	channel_ctx* ctx = tina_job_get_description(job)->user_data;
+	unsigned values[10];
+	// Send batches larger than the channel so the producers fill it up and wait.
+	for(unsigned i = 0; i < CHANNEL_VALUES; i += 10){
+		for(unsigned j = 0; j < 10; j++) values[j] = i + j + 1;
+		assert(tina_channel_send(job, ctx->chan, values, 10) == 10);
+	}
+}
+
+static void channel_consumer(tina_job* job){
+	channel_ctx* ctx = tina_job_get_description(job)->user_data;
+	unsigned values[3];
+	size_t count;
+	while((count = tina_channel_recv(job, ctx->chan, values, 3))){
+		mtx_lock(&ctx->lock);
+		for(size_t i = 0; i < count; i++) ctx->sum += values[i];
+		ctx->received += count;
+		mtx_unlock(&ctx->lock);
+	}
+}
+
+static void channel_send_one(tina_job* job){
+	channel_ctx* ctx = tina_job_get_description(job)->user_data;
+	unsigned value = 5;
+	assert(tina_channel_send(job, ctx->chan, &value, 1) == 1);
+}
+
+static void test_channel(tina_job* job){
+	channel_ctx ctx = {.chan = tina_channel_new(sizeof(unsigned), 8), .sum = 0};
+	mtx_init(&ctx.lock, mtx_plain);
+	tina_group producers = {0}, consumers = {0};
+	for(unsigned i = 0; i < 4; i++) tina_scheduler_enqueue(SCHED, NULL, channel_consumer, &ctx, i, QUEUE_WORK, &consumers);
+	for(unsigned i = 0; i < 4; i++) tina_scheduler_enqueue(SCHED, NULL, channel_producer, &ctx, i, QUEUE_WORK, &producers);
+	
+	// Consumers keep going until the channel is closed and empty.
+	tina_job_wait(job, &producers, 0);
+	tina_channel_close(SCHED, ctx.chan);
+	tina_job_wait(job, &consumers, 0);
+	assert(ctx.received == 4*CHANNEL_VALUES);
+	assert(ctx.sum == 4ull*CHANNEL_VALUES*(CHANNEL_VALUES + 1)/2);
+	
+	unsigned value = 1;
+	assert(tina_channel_send(job, ctx.chan, &value, 1) == 0);
+	assert(tina_channel_recv(job, ctx.chan, &value, 1) == 0);
+	tina_channel_free(ctx.chan);
+	
+	// Non-blocking versions only move what fits.
+	unsigned values[4] = {1, 2, 3, 4};
+	ctx.chan = tina_channel_new(sizeof(unsigned), 3);
+	assert(tina_channel_try_recv(SCHED, ctx.chan, values, 4) == 0);
+	assert(tina_channel_try_send(SCHED, ctx.chan, values, 4) == 3);
+	assert(tina_channel_try_send(SCHED, ctx.chan, values, 4) == 0);
+	assert(tina_channel_try_recv(SCHED, ctx.chan, values + 1, 2) == 2 && values[1] == 1 && values[2] == 2);
+	tina_channel_close(SCHED, ctx.chan);
+	assert(tina_channel_try_send(SCHED, ctx.chan, values, 1) == 0);
+	assert(tina_channel_recv(job, ctx.chan, values, 4) == 1 && values[0] == 3);
+	tina_channel_free(ctx.chan);
+	
+	// Any room at all should wake a sender waiting on a full channel.
+	ctx.chan = tina_channel_new(sizeof(unsigned), 4);
+	assert(tina_channel_try_send(SCHED, ctx.chan, values, 4) == 4);
+	unsigned waiting = jobs_waiting();
+	tina_group sender = {0};
+	tina_scheduler_enqueue(SCHED, NULL, channel_send_one, &ctx, 0, QUEUE_WORK, &sender);
+	yield_until_waiting(job, waiting);
+	assert(tina_channel_try_recv(SCHED, ctx.chan, values, 1) == 1);
+	tina_job_wait(job, &sender, 0);
+	assert(tina_channel_try_recv(SCHED, ctx.chan, values, 4) == 4);
+	tina_channel_free(ctx.chan);
+	
+	mtx_destroy(&ctx.lock);
+	puts("test_channel() success");
+}
+
+static void run_tests(tina_job* job){
+	test_job_mutex(job);
+	test_job_rwlock(job);
+	test_job_semaphore(job);
+	test_channel(job);
+	tina_scheduler_interrupt(SCHED, QUEUE_MAIN);
+}
+
+int main(int argc, const char *argv[]){
+	SCHED = tina_scheduler_new(1024, _QUEUE_COUNT, 65, 64*1024);
+	common_start_worker_threads(1, SCHED, QUEUE_WORK);
+	
+	tina_scheduler_enqueue(SCHED, NULL, run_tests, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_LOOP);
+	
+	tina_scheduler_interrupt(SCHED, QUEUE_WORK);
+	common_destroy_worker_threads();
+	
+	return EXIT_SUCCESS;
+}
@@ -20,8 +20,11 @@
 	SOFTWARE.
 */
 
+// Test waiting on groups from jobs and from other threads, and the run modes that stop at a group or a budget.
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include <assert.h>
 
 #include "tina.h"
@@ -54,7 +57,8 @@ static void test_wait_countdown_sync(tina_job* job){
 	}
 	
 	while(counter){
-		unsigned expected = counter - 2;
+		// The first of the 2 to complete releases this job to run next, before the other one finishes.
+		unsigned expected = counter - 1;
 		counter = tina_job_wait(job, &group, counter - 1);
 		assert(counter == expected);
 	}
@@ -119,22 +123,212 @@ static void test_wait_multiple(tina_job* job){
 	puts("test_wait_multiple() success");
 }
 
+static void run_next_filler(tina_job* job){
+	unsigned* filler_count = tina_job_get_description(job)->user_data;
+	(*filler_count)++;
+}
+
+static void run_next_child(tina_job* job){}
+
+static void test_run_next(tina_job* job){
+	unsigned filler_count = 0;
+	tina_group child_group = {0}, filler_group = {0};
+	
+	// Queue a child job followed by a bunch of other jobs.
+	tina_scheduler_enqueue(SCHED, NULL, run_next_child, NULL, 0, QUEUE_MAIN, &child_group);
+	for(unsigned i = 0; i < 8; i++) tina_scheduler_enqueue(SCHED, NULL, run_next_filler, &filler_count, i, QUEUE_MAIN, &filler_group);
+	
+	// Completing the child should run this job next, before anything else in the queue.
+	tina_job_wait(job, &child_group, 0);
+	assert(filler_count == 0);
+	
+	tina_job_wait(job, &filler_group, 0);
+	assert(filler_count == 8);
+	puts("test_run_next() success");
+}
+
+typedef struct {
+	unsigned begin, end;
+	uint64_t sum;
+} sum_range;
+
+static void recursive_sum(tina_job* job){
+	sum_range* range = tina_job_get_description(job)->user_data;
+	if(range->end - range->begin == 1){
+		range->sum = range->begin;
+		return;
+	}
+	
+	unsigned mid = (range->begin + range->end)/2;
+	sum_range halves[] = {{range->begin, mid, 0}, {mid, range->end, 0}};
+	tina_group group = {0};
+	tina_scheduler_enqueue(SCHED, NULL, recursive_sum, &halves[0], 0, QUEUE_WORK, &group);
+	tina_scheduler_enqueue(SCHED, NULL, recursive_sum, &halves[1], 0, QUEUE_WORK, &group);
+	tina_job_wait_help(job, &group, 0);
+	range->sum = halves[0].sum + halves[1].sum;
+}
+
+static void test_wait_help(tina_job* job){
+	// Waiting normally would need a fiber for each of the 1023 splits, far more than the scheduler has.
+	sum_range range = {0, 1024, 0};
+	tina_group group = {0};
+	tina_scheduler_enqueue(SCHED, NULL, recursive_sum, &range, 0, QUEUE_WORK, &group);
+	tina_job_wait(job, &group, 0);
+	assert(range.sum == 1023*1024/2);
+	
+	puts("test_wait_help() success");
+}
+
+typedef struct {
+	tina_group gate;
+	bool open;
+	unsigned started, max_depth;
+} help_depth_ctx;
+
+static void help_depth_gate(tina_job* job){
+	help_depth_ctx* ctx = tina_job_get_description(job)->user_data;
+	while(!ctx->open) tina_job_yield(job);
+}
+
+static void help_depth_nest(tina_job* job){
+	help_depth_ctx* ctx = tina_job_get_description(job)->user_data;
+	ctx->started++;
+	
+	// Jobs that started but aren't suspended are still nested on the main thread, including the test job itself.
+	tina_stats stats;
+	tina_scheduler_stats(SCHED, &stats, NULL);
+	unsigned depth = ctx->started + 1 - stats.jobs_waiting;
+	if(ctx->max_depth < depth) ctx->max_depth = depth;
+	
+	// Hold the gate closed until every job has started, so they all help while waiting on it.
+	if(ctx->started == 16) ctx->open = true;
+	tina_job_wait_help(job, &ctx->gate, 0);
+}
+
+static void test_help_depth(tina_job* job){
+	help_depth_ctx ctx = {.gate = {0}};
+	tina_group group = {0};
+	tina_scheduler_enqueue(SCHED, NULL, help_depth_gate, &ctx, 0, QUEUE_WORK, &ctx.gate);
+	for(unsigned i = 0; i < 16; i++) tina_scheduler_enqueue(SCHED, NULL, help_depth_nest, &ctx, i, QUEUE_MAIN, &group);
+	
+	// None of the jobs are in the group being waited on, so they only nest until the depth limit. (_TINA_HELP_DEPTH defaults to 4)
+	tina_job_wait_help(job, &ctx.gate, 0);
+	tina_job_wait(job, &group, 0);
+	assert(ctx.started == 16);
+	assert(ctx.max_depth > 1 && ctx.max_depth <= 1 + 4);
+	
+	puts("test_help_depth() success");
+}
+
 static void run_tests(tina_job* job){
 	test_wait_countdown_sync(job);
 	test_wait_countdown_async(job);
 	test_wait_multiple(job);
+	test_run_next(job);
+	test_wait_help(job);
+	test_help_depth(job);
 	tina_scheduler_interrupt(SCHED, QUEUE_MAIN);
 }
 
+static void count_job(tina_job* job){
+	unsigned* count = tina_job_get_description(job)->user_data;
+	(*count)++;
+}
+
+// Called from the main thread outside of any job.
+static void test_wait_blocking(void){
+	unsigned work_count = 0, main_count = 0;
+	tina_group group = {0};
+	
+	// Sleep while the worker thread runs the jobs.
+	for(unsigned i = 0; i < 100; i++) tina_scheduler_enqueue(SCHED, NULL, count_job, &work_count, i, QUEUE_WORK, &group);
+	assert(tina_group_wait_blocking(SCHED, &group, 0, TINA_NO_QUEUE) == 0);
+	assert(work_count == 100);
+	
+	// Nothing else runs the main queue, so this thread has to help.
+	for(unsigned i = 0; i < 100; i++) tina_scheduler_enqueue(SCHED, NULL, count_job, &main_count, i, QUEUE_MAIN, &group);
+	assert(tina_group_wait_blocking(SCHED, &group, 0, QUEUE_MAIN) == 0);
+	assert(main_count == 100);
+	
+	puts("test_wait_blocking() success");
+}
+
+static void sleep_job(tina_job* job){
+	thrd_sleep(&(struct timespec){.tv_nsec = 1000000}, NULL);
+	count_job(job);
+}
+
+// Called from the main thread outside of any job.
+static void test_run_modes(void){
+	unsigned group_count = 0, other_count = 0;
+	tina_group group = {0};
+	
+	// Jobs are run in order, so the ones queued after the group are left alone.
+	for(unsigned i = 0; i < 10; i++) tina_scheduler_enqueue(SCHED, NULL, count_job, &group_count, i, QUEUE_MAIN, &group);
+	for(unsigned i = 0; i < 10; i++) tina_scheduler_enqueue(SCHED, NULL, count_job, &other_count, i, QUEUE_MAIN, NULL);
+	assert(tina_scheduler_run_limited(SCHED, QUEUE_MAIN, TINA_RUN_UNTIL_GROUP, &(tina_run_limits){.group = &group}));
+	assert(group_count == 10 && other_count == 0);
+	
+	// Limit by job count.
+	assert(tina_scheduler_run_limited(SCHED, QUEUE_MAIN, TINA_RUN_BUDGET, &(tina_run_limits){.max_jobs = 3}));
+	assert(other_count == 3);
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_FLUSH);
+	assert(other_count == 10);
+	
+	// The main queue is empty, so it sleeps until the worker thread finishes the group.
+	group_count = 0;
+	for(unsigned i = 0; i < 10; i++) tina_scheduler_enqueue(SCHED, NULL, sleep_job, &group_count, i, QUEUE_WORK, &group);
+	assert(!tina_scheduler_run_limited(SCHED, QUEUE_MAIN, TINA_RUN_UNTIL_GROUP, &(tina_run_limits){.group = &group}));
+	assert(group_count == 10);
+	// Adding to a group with a limit of 1 only works if it's empty.
+	assert(tina_group_increment(SCHED, &group, 1, 1) == 1);
+	tina_group_decrement(SCHED, &group, 1);
+	
+	// Limit by time. Each job takes at least 1 ms, so a 5 ms budget can't run more than 5 of them.
+	unsigned sleep_count = 0;
+	for(unsigned i = 0; i < 100; i++) tina_scheduler_enqueue(SCHED, NULL, sleep_job, &sleep_count, i, QUEUE_MAIN, NULL);
+	tina_scheduler_run_limited(SCHED, QUEUE_MAIN, TINA_RUN_BUDGET, &(tina_run_limits){.nanoseconds = 5000000});
+	assert(1 <= sleep_count && sleep_count <= 5);
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_FLUSH);
+	assert(sleep_count == 100);
+	
+	puts("test_run_modes() success");
+}
+
+#ifdef TINA_JOBS_LATENCY
+static void print_histogram(const char* label, const tina_histogram* hist){
+	printf("  %-10s count: %6"PRIu64", p50: %8"PRIu64"ns, p99: %8"PRIu64"ns, p999: %8"PRIu64"ns, max: %8"PRIu64"ns\n", label, hist->count,
+		tina_histogram_percentile(hist, 50), tina_histogram_percentile(hist, 99), tina_histogram_percentile(hist, 99.9), hist->max
+	);
+}
+
+static void print_latency(const char* name, unsigned queue_idx){
+	static tina_queue_latency latency;
+	tina_scheduler_latency(SCHED, queue_idx, &latency, false);
+	
+	printf("%s latency:\n", name);
+	print_histogram("queued", &latency.queued);
+	print_histogram("suspended", &latency.suspended);
+	print_histogram("wake", &latency.wake);
+}
+#endif
+
 int main(int argc, const char *argv[]){
 	SCHED = tina_scheduler_new(1024, _QUEUE_COUNT, 65, 64*1024);
 	common_start_worker_threads(1, SCHED, QUEUE_WORK);
 	
 	tina_scheduler_enqueue(SCHED, NULL, run_tests, NULL, 0, QUEUE_MAIN, NULL);
 	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_LOOP);
+	test_wait_blocking();
+	test_run_modes();
 	
 	tina_scheduler_interrupt(SCHED, QUEUE_WORK);
 	common_destroy_worker_threads();
 	
+#ifdef TINA_JOBS_LATENCY
+	print_latency("QUEUE_MAIN", QUEUE_MAIN);
+	print_latency("QUEUE_WORK", QUEUE_WORK);
+#endif
+	
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,145 @@
+/*
+	Copyright (c) 2021 Scott Lembcke
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+// Test the current job and worker index accessors, worker queues, and reusing worker indexes as threads come and go.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "tina.h"
+#include "tina_jobs.h"
+#include "common/common.h"
+
+enum {
+	QUEUE_MAIN,
+	QUEUE_WORK,
+	_QUEUE_COUNT,
+};
+
+tina_scheduler* SCHED;
+
+static void current_job(tina_job* job){
+	unsigned* worker_bits = tina_job_get_description(job)->user_data;
+	assert(tina_job_current() == job);
+	assert(tina_worker_index(SCHED) < tina_worker_count(SCHED));
+	*worker_bits |= 1u << tina_worker_index(SCHED);
+}
+
+static void test_current(tina_job* job){
+	unsigned worker_bits = 0;
+	tina_group group = {0};
+	assert(tina_job_current() == job);
+	
+	tina_scheduler_enqueue(SCHED, NULL, current_job, &worker_bits, 0, QUEUE_MAIN, &group);
+	tina_scheduler_enqueue(SCHED, NULL, current_job, &worker_bits, 0, QUEUE_WORK, &group);
+	// Wait without passing the job through.
+	tina_job_wait(tina_job_current(), &group, 0);
+	assert(tina_job_current() == job);
+	
+	// The main thread and the worker thread should have different indexes.
+	assert(tina_worker_count(SCHED) == 2);
+	assert(worker_bits == 3);
+	puts("test_current() success");
+}
+
+typedef struct {
+	unsigned main_worker, order[2], count;
+} worker_queue_ctx;
+
+static void worker_queue_hop(tina_job* job){
+	worker_queue_ctx* ctx = tina_job_get_description(job)->user_data;
+	unsigned start_worker = tina_worker_index(SCHED);
+	assert(start_worker != ctx->main_worker);
+	
+	// Hop over to the main thread and back again.
+	tina_job_switch_queue(job, TINA_WORKER_QUEUE(ctx->main_worker));
+	assert(tina_worker_index(SCHED) == ctx->main_worker);
+	tina_job_switch_queue(job, TINA_WORKER_QUEUE(start_worker));
+	assert(tina_worker_index(SCHED) == start_worker);
+}
+
+static void worker_queue_order(tina_job* job){
+	worker_queue_ctx* ctx = tina_job_get_description(job)->user_data;
+	assert(tina_worker_index(SCHED) == ctx->main_worker);
+	ctx->order[ctx->count++] = (unsigned)tina_job_get_description(job)->user_idx;
+}
+
+static void test_worker_queue(tina_job* job){
+	worker_queue_ctx ctx = {.main_worker = tina_worker_index(SCHED)};
+	tina_group group = {0};
+	
+	tina_scheduler_enqueue(SCHED, NULL, worker_queue_hop, &ctx, 0, QUEUE_WORK, &group);
+	tina_job_wait(job, &group, 0);
+	
+	// The worker queue should run before the queue the main thread is running.
+	tina_scheduler_enqueue(SCHED, NULL, worker_queue_order, &ctx, 0, QUEUE_MAIN, &group);
+	tina_scheduler_enqueue(SCHED, NULL, worker_queue_order, &ctx, 1, TINA_WORKER_QUEUE(ctx.main_worker), &group);
+	tina_job_wait(job, &group, 0);
+	assert(ctx.count == 2 && ctx.order[0] == 1 && ctx.order[1] == 0);
+	
+	puts("test_worker_queue() success");
+}
+
+static void run_tests(tina_job* job){
+	test_current(job);
+	test_worker_queue(job);
+	tina_scheduler_interrupt(SCHED, QUEUE_MAIN);
+}
+
+static void count_job(tina_job* job){
+	unsigned* count = tina_job_get_description(job)->user_data;
+	(*count)++;
+}
+
+
+// Called from the main thread once the other worker threads have stopped.
+static void test_worker_recycling(void){
+	unsigned count = 0;
+	tina_group group = {0};
+	
+	// Threads release their worker index when they stop, so starting more of them over time than fit at once is fine.
+	for(unsigned i = 0; i < 2*TINA_MAX_WORKERS + 1; i++){
+		tina_workers* workers = tina_workers_start(SCHED, QUEUE_WORK, 1, TINA_AFFINITY_NONE, "recycle");
+		tina_scheduler_enqueue(SCHED, NULL, count_job, &count, i, QUEUE_WORK, &group);
+		tina_group_wait_blocking(SCHED, &group, 0, TINA_NO_QUEUE);
+		tina_workers_stop(workers);
+	}
+	
+	assert(count == 2*TINA_MAX_WORKERS + 1);
+	assert(tina_worker_count(SCHED) <= TINA_MAX_WORKERS);
+	puts("test_worker_recycling() success");
+}
+
+int main(int argc, const char *argv[]){
+	SCHED = tina_scheduler_new(1024, _QUEUE_COUNT, 65, 64*1024);
+	common_start_worker_threads(1, SCHED, QUEUE_WORK);
+	
+	tina_scheduler_enqueue(SCHED, NULL, run_tests, NULL, 0, QUEUE_MAIN, NULL);
+	tina_scheduler_run(SCHED, QUEUE_MAIN, TINA_RUN_LOOP);
+	
+	tina_scheduler_interrupt(SCHED, QUEUE_WORK);
+	common_destroy_worker_threads();
+	test_worker_recycling();
+	
+	return EXIT_SUCCESS;
+}
@@ -90,6 +90,10 @@ extern const tina TINA_EMPTY;
 // Swap between two symmetric coroutines, passing a value between them.
 uintptr_t tina_swap(tina* from, tina* to, uintptr_t value);
 
+// Get the coroutine that is running on the calling thread, or NULL if it's running on the thread's own stack.
+// Only available when TINA_CURRENT is defined.
+tina* tina_current(void);
+
 #ifdef TINA_IMPLEMENTATION
 
 #ifndef TINA_NO_CRT
@@ -110,6 +114,24 @@ uintptr_t tina_swap(tina* from, tina* to, uintptr_t value);
 // Alignment to use for all types. (MSVC doesn't provide stdalign.h -_-)
 #define _TINA_MAX_ALIGN ((size_t)16)
 
+#ifndef _TINA_SWAP_HOOK
+// Override this to be notified right before the running coroutine 'from' switches stacks to 'to'.
+// NULL stands for the stack that called tina_init() or tina_resume(), which is the thread's own stack unless coroutines are nested.
+// Copies of TINA_EMPTY are passed as NULL too, since they don't have a stack of their own.
+// Ex: Sampling profilers or allocators with per-stack caches.
+#define _TINA_SWAP_HOOK(_FROM_, _TO_)
+#endif
+
+#ifndef _TINA_THREAD_LOCAL
+	#if __cplusplus
+		#define _TINA_THREAD_LOCAL thread_local
+	#elif _MSC_VER
+		#define _TINA_THREAD_LOCAL __declspec(thread)
+	#else
+		#define _TINA_THREAD_LOCAL _Thread_local
+	#endif
+#endif
+
 const tina TINA_EMPTY = {
 	.user_data = NULL, .name = "TINA_EMPTY",
 	.buffer = NULL, .size = 0, .completed = false,
@@ -128,6 +150,30 @@ const tina TINA_EMPTY = {
 	extern tina* _tina_init_stack(tina* coro, tina_func* body, void** sp_loc, void* sp);
 #endif
 
+#ifdef TINA_CURRENT
+// The coroutine running on this thread. Set by tina_swap() and restored when tina_resume() returns.
+static _TINA_THREAD_LOCAL tina* _TINA_CURRENT_CORO = NULL;
+
+tina* tina_current(void){return _TINA_CURRENT_CORO;}
+#endif
+
+// The inline assembly backends that build a base frame record at the top of the coroutine's stack.
+#if !(__WIN64__ || _WIN64) && ((__amd64__ && (__unix__ || __APPLE__)) || (__aarch64__ && __GNUC__))
+	#define _TINA_BASE_FRAME 1
+#endif
+
+#if defined(TINA_LINK_FRAMES) && _TINA_BASE_FRAME
+	// Address in _tina_swap() where a suspended caller's registers have all been saved.
+	extern const uint8_t _tina_swap_resume[];
+	
+	// _tina_init_stack() pushes 4 words below the aligned stack top:
+	// [0] saved frame pointer, [1] return address: a frame record for frame pointer unwinders.
+	// [2] return address, [3] pointer to the caller's saved stack pointer: read by the DWARF CFI.
+	static void** _tina_base_frame(tina* coro){
+		return (void**)((uintptr_t)coro->_canary_end & -_TINA_MAX_ALIGN) - 4;
+	}
+#endif
+
 tina* tina_init(void* buffer, size_t size, tina_func* body, void* user_data){
 	_TINA_ASSERT(size >= 64*1024, "Tina Warning: Small stacks tend to not work on modern OSes. (Feel free to disable this if you have your reasons)");
 #ifndef TINA_NO_CRT
@@ -153,9 +199,18 @@ tina* tina_init(void* buffer, size_t size, tina_func* body, void* user_data){
 	// Empty coroutine for the init function to use for a return location.
 	tina dummy = TINA_EMPTY;
 	coro->_caller = &dummy;
-
+	
+	_TINA_SWAP_HOOK((tina*)NULL, coro);
+#ifdef TINA_CURRENT
+	tina* current = _TINA_CURRENT_CORO;
+	_TINA_CURRENT_CORO = coro;
+#endif
 	typedef tina* init_func(tina* coro, tina_func* body, void** sp_loc, void* sp);
-	return ((init_func*)_tina_init_stack)(coro, body, &dummy._sp, stack_top);
+	coro = ((init_func*)_tina_init_stack)(coro, body, &dummy._sp, stack_top);
+#ifdef TINA_CURRENT
+	_TINA_CURRENT_CORO = current;
+#endif
+	return coro;
 }
 
 void _tina_context(tina* coro, tina_func* body){
@@ -178,6 +233,14 @@ void _tina_context(tina* coro, tina_func* body){
 uintptr_t tina_swap(tina* from, tina* to, uintptr_t value){
 	_TINA_ASSERT(from->_canary == TINA_EMPTY._canary, "Tina Error: Bad canary value. Coroutine has likely had a stack overflow.");
 	_TINA_ASSERT(*from->_canary_end == TINA_EMPTY._canary, "Tina Error: Bad canary value. Coroutine has likely had a stack underflow.");
+	// Coroutines without a buffer are placeholders for the thread's stack, like the ones tina_resume() returns to.
+	tina* from_coro = from->buffer ? from : NULL;
+	tina* to_coro = to->buffer ? to : NULL;
+	_TINA_SWAP_HOOK(from_coro, to_coro);
+#ifdef TINA_CURRENT
+	_TINA_CURRENT_CORO = to_coro;
+#endif
+	(void)from_coro, (void)to_coro;
 	typedef uintptr_t swap(void** sp_from, void** sp_to, uintptr_t value);
 	return ((swap*)_tina_swap)(&from->_sp, &to->_sp, value);
 }
@@ -186,7 +249,28 @@ uintptr_t tina_resume(tina* coro, uintptr_t value){
 	_TINA_ASSERT(!coro->_caller, "Tina Error: tina_resume() called on a coroutine that hasn't yielded yet.");
 	tina dummy = TINA_EMPTY;
 	coro->_caller = &dummy;
-	return tina_swap(&dummy, coro, value);
+#ifdef TINA_CURRENT
+	// Yielding back to 'dummy' clears the current coroutine, so remember what was really running.
+	tina* current = _TINA_CURRENT_CORO;
+#endif
+#if defined(TINA_LINK_FRAMES) && _TINA_BASE_FRAME
+	// Link the coroutine's base frame to this one so unwinders can walk out of the coroutine into the caller.
+	void** base = _tina_base_frame(coro);
+	base[0] = *(void**)__builtin_frame_address(0);
+	base[1] = __builtin_return_address(0);
+	base[2] = (void*)_tina_swap_resume;
+	base[3] = &dummy._sp;
+#endif
+	uintptr_t result = tina_swap(&dummy, coro, value);
+#if defined(TINA_LINK_FRAMES) && _TINA_BASE_FRAME
+	// Unlink it again so a suspended coroutine's stack ends at _tina_context().
+	base[0] = base[1] = base[2] = NULL;
+	base[3] = &base[3];
+#endif
+#ifdef TINA_CURRENT
+	_TINA_CURRENT_CORO = current;
+#endif
+	return result;
 }
 
 uintptr_t tina_yield(tina* coro, uintptr_t value){
@@ -211,37 +295,65 @@ uintptr_t tina_yield(tina* coro, uintptr_t value){
 	
 	// _tina_init_stack() sets up the stack and initial execution of the coroutine.
 	asm("_tina_init_stack:");
+	// The .cfi directives describe the stack layout so debuggers and profilers can unwind through these functions.
+	asm("  .cfi_startproc");
 	// First things first, save the registers protected by the ABI
 	asm("  push {r4-r11, lr}");
+	asm("  .cfi_def_cfa_offset 36");
+	asm("  .cfi_offset r4, -36\n  .cfi_offset r5, -32\n  .cfi_offset r6, -28\n  .cfi_offset r7, -24");
+	asm("  .cfi_offset r8, -20\n  .cfi_offset r9, -16\n  .cfi_offset r10, -12\n  .cfi_offset r11, -8");
+	asm("  .cfi_offset lr, -4");
 	asm("  vpush {q4-q7}");
+	asm("  .cfi_def_cfa_offset 100");
+	asm("  .cfi_offset d8, -100\n  .cfi_offset d9, -92\n  .cfi_offset d10, -84\n  .cfi_offset d11, -76");
+	asm("  .cfi_offset d12, -68\n  .cfi_offset d13, -60\n  .cfi_offset d14, -52\n  .cfi_offset d15, -44");
 	// Now store the stack pointer in the couroutine.
 	// _tina_context() will call tina_yield() to restore the stack and registers later.
 	asm("  str sp, [r2]");
 	// Align the stack top to 16 bytes as requested by the ABI and set it to the stack pointer.
 	asm("  and r3, r3, #~0xF");
 	asm("  mov sp, r3");
+	// This is the bottom of the coroutine's stack. Tell unwinders there is no caller to return to.
+	asm("  .cfi_def_cfa_offset 0");
+	asm("  .cfi_undefined lr");
 	// Finally, tail call into _tina_context.
 	// By setting the caller to null, debuggers will show _tina_context() as a base stack frame.
 	asm("  mov lr, #0");
 	asm("  b _tina_context");
+	asm("  .cfi_endproc");
 	
 	// https://static.docs.arm.com/ihi0042/g/aapcs32.pdf
 	// _tina_swap() is responsible for swapping out the registers and stack pointer.
 	asm("_tina_swap:");
+	asm("  .cfi_startproc");
 	// Like above, save the ABI protected registers and save the stack pointer.
 	asm("  push {r4-r11, lr}");
+	asm("  .cfi_def_cfa_offset 36");
+	asm("  .cfi_offset r4, -36\n  .cfi_offset r5, -32\n  .cfi_offset r6, -28\n  .cfi_offset r7, -24");
+	asm("  .cfi_offset r8, -20\n  .cfi_offset r9, -16\n  .cfi_offset r10, -12\n  .cfi_offset r11, -8");
+	asm("  .cfi_offset lr, -4");
 	asm("  vpush {q4-q7}");
+	asm("  .cfi_def_cfa_offset 100");
+	asm("  .cfi_offset d8, -100\n  .cfi_offset d9, -92\n  .cfi_offset d10, -84\n  .cfi_offset d11, -76");
+	asm("  .cfi_offset d12, -68\n  .cfi_offset d13, -60\n  .cfi_offset d14, -52\n  .cfi_offset d15, -44");
 	// Save stack pointer for the old coroutine, and load the new one.
+	// Both stacks have the same layout here, so the CFI above stays valid across the switch.
 	asm("  str sp, [r0]");
 	asm("  ldr sp, [r1]");
 	// Restore the new coroutine's protected registers.
 	asm("  vpop {q4-q7}");
+	asm("  .cfi_def_cfa_offset 36");
 	asm("  pop {r4-r11, lr}");
+	asm("  .cfi_def_cfa_offset 0");
+	asm("  .cfi_restore r4\n  .cfi_restore r5\n  .cfi_restore r6\n  .cfi_restore r7");
+	asm("  .cfi_restore r8\n  .cfi_restore r9\n  .cfi_restore r10\n  .cfi_restore r11");
+	asm("  .cfi_restore lr");
 	// Move the 'value' parameter to the return value register.
 	asm("  mov r0, r2");
 	// And perform a normal return instruction.
 	// This will return from tina_yield() in the new coroutine.
 	asm("  bx lr");
+	asm("  .cfi_endproc");
 #elif __amd64__ && (__unix__ || __APPLE__)
 	#define ARG0 "rdi"
 	#define ARG1 "rsi"
@@ -249,39 +361,65 @@ uintptr_t tina_yield(tina* coro, uintptr_t value){
 	#define ARG3 "rcx"
 	#define RET "rax"
 	
+	#ifdef TINA_LINK_FRAMES
+		// Linked base frame: CFA = *base[3] (the caller's saved stack pointer), return address = base[2].
+		// DW_CFA_def_cfa_expression(DW_OP_breg7(rsp) 24, DW_OP_deref, DW_OP_deref), DW_CFA_expression(rip, DW_OP_breg7 16)
+		#define _TINA_CFI_BASE_FRAME "  .cfi_escape 0x0f, 0x04, 0x77, 0x18, 0x06, 0x06\n  .cfi_escape 0x10, 0x10, 0x02, 0x77, 0x10"
+	#else
+		#define _TINA_CFI_BASE_FRAME "  .cfi_undefined rip"
+	#endif
+	
+	#define _TINA_CFI_PUSH(reg) asm("  push " #reg "\n  .cfi_adjust_cfa_offset 8\n  .cfi_rel_offset " #reg ", 0")
+	#define _TINA_CFI_POP(reg) asm("  pop " #reg "\n  .cfi_adjust_cfa_offset -8\n  .cfi_restore " #reg)
+	
 	asm(".intel_syntax noprefix");
 	
 	asm(_TINA_SYMBOL(_tina_init_stack:));
-	asm("  push rbp");
-	asm("  push rbx");
-	asm("  push r12");
-	asm("  push r13");
-	asm("  push r14");
-	asm("  push r15");
+	asm("  .cfi_startproc");
+	_TINA_CFI_PUSH(rbp);
+	_TINA_CFI_PUSH(rbx);
+	_TINA_CFI_PUSH(r12);
+	_TINA_CFI_PUSH(r13);
+	_TINA_CFI_PUSH(r14);
+	_TINA_CFI_PUSH(r15);
 	asm("  mov [" ARG2 "], rsp");
 	asm("  and " ARG3 ", ~0xF");
 	asm("  mov rsp, " ARG3);
+	asm("  .cfi_def_cfa_offset 0\n  .cfi_undefined rip");
+	asm("  .cfi_restore rbp\n  .cfi_restore rbx\n  .cfi_restore r12\n  .cfi_restore r13\n  .cfi_restore r14\n  .cfi_restore r15");
+	// Build the (unlinked) base frame described in _tina_base_frame().
+	asm("  lea rax, [rsp - 8]");
+	asm("  push rax");
+	asm("  push 0");
 	asm("  push 0");
-	asm("  jmp " _TINA_SYMBOL(_tina_context));
+	asm("  push 0");
+	asm("  mov rbp, rsp");
+	asm(_TINA_CFI_BASE_FRAME);
+	asm("  call " _TINA_SYMBOL(_tina_context));
+	asm("  ud2");
+	asm("  .cfi_endproc");
 	
 	// https://software.intel.com/sites/default/files/article/402129/mpx-linux64-abi.pdf
 	asm(_TINA_SYMBOL(_tina_swap:));
-	asm("  push rbp");
-	asm("  push rbx");
-	asm("  push r12");
-	asm("  push r13");
-	asm("  push r14");
-	asm("  push r15");
+	asm("  .cfi_startproc");
+	_TINA_CFI_PUSH(rbp);
+	_TINA_CFI_PUSH(rbx);
+	_TINA_CFI_PUSH(r12);
+	_TINA_CFI_PUSH(r13);
+	_TINA_CFI_PUSH(r14);
+	_TINA_CFI_PUSH(r15);
 	asm("  mov [" ARG0 "], rsp");
+	asm(_TINA_SYMBOL(_tina_swap_resume:));
 	asm("  mov rsp, [" ARG1 "]");
-	asm("  pop r15");
-	asm("  pop r14");
-	asm("  pop r13");
-	asm("  pop r12");
-	asm("  pop rbx");
-	asm("  pop rbp");
+	_TINA_CFI_POP(r15);
+	_TINA_CFI_POP(r14);
+	_TINA_CFI_POP(r13);
+	_TINA_CFI_POP(r12);
+	_TINA_CFI_POP(rbx);
+	_TINA_CFI_POP(rbp);
 	asm("  mov " RET ", " ARG2);
 	asm("  ret");
+	asm("  .cfi_endproc");
 	
 	asm(".att_syntax");
 #elif __WIN64__ || _WIN64
@@ -331,8 +469,26 @@ uintptr_t tina_yield(tina* coro, uintptr_t value){
 		0x5e5f5c415d415e41, 0x9090c3c0894c5d5b,
 	};
 #elif __aarch64__ && __GNUC__
+	#ifdef TINA_LINK_FRAMES
+		// Linked base frame: CFA = *base[3] (the caller's saved stack pointer), return address = base[2].
+		// DW_CFA_def_cfa_expression(DW_OP_breg31(sp) 24, DW_OP_deref, DW_OP_deref), DW_CFA_expression(x30, DW_OP_breg31 16)
+		#define _TINA_CFI_BASE_FRAME "  .cfi_escape 0x0f, 0x04, 0x8f, 0x18, 0x06, 0x06\n  .cfi_escape 0x10, 0x1e, 0x02, 0x8f, 0x10"
+	#else
+		#define _TINA_CFI_BASE_FRAME "  .cfi_undefined x30"
+	#endif
+	
+	// Locations of the registers saved by the stp instructions below, relative to the stack pointer.
+	#define _TINA_CFI_SAVED() \
+		asm("  .cfi_rel_offset x19, 0x00\n  .cfi_rel_offset x20, 0x08\n  .cfi_rel_offset x21, 0x10\n  .cfi_rel_offset x22, 0x18"); \
+		asm("  .cfi_rel_offset x23, 0x20\n  .cfi_rel_offset x24, 0x28\n  .cfi_rel_offset x25, 0x30\n  .cfi_rel_offset x26, 0x38"); \
+		asm("  .cfi_rel_offset x27, 0x40\n  .cfi_rel_offset x28, 0x48\n  .cfi_rel_offset x29, 0x50\n  .cfi_rel_offset x30, 0x58"); \
+		asm("  .cfi_rel_offset d8, 0x60\n  .cfi_rel_offset d9, 0x68\n  .cfi_rel_offset d10, 0x70\n  .cfi_rel_offset d11, 0x78"); \
+		asm("  .cfi_rel_offset d12, 0x80\n  .cfi_rel_offset d13, 0x88\n  .cfi_rel_offset d14, 0x90\n  .cfi_rel_offset d15, 0x98")
+	
 	asm(_TINA_SYMBOL(_tina_init_stack:));
+	asm("  .cfi_startproc");
 	asm("  sub sp, sp, 0xA0");
+	asm("  .cfi_def_cfa_offset 0xA0");
 	asm("  stp x19, x20, [sp, 0x00]");
 	asm("  stp x21, x22, [sp, 0x10]");
 	asm("  stp x23, x24, [sp, 0x20]");
@@ -343,15 +499,30 @@ uintptr_t tina_yield(tina* coro, uintptr_t value){
 	asm("  stp d10, d11, [sp, 0x70]");
 	asm("  stp d12, d13, [sp, 0x80]");
 	asm("  stp d14, d15, [sp, 0x90]");
+	_TINA_CFI_SAVED();
 	asm("  mov x4, sp");
 	asm("  str x4, [x2]");
 	asm("  and x3, x3, #~0xF");
 	asm("  mov sp, x3");
-	asm("  mov lr, #0");
-	asm("  b " _TINA_SYMBOL(_tina_context));
+	asm("  .cfi_def_cfa_offset 0\n  .cfi_undefined x30");
+	asm("  .cfi_restore x19\n  .cfi_restore x20\n  .cfi_restore x21\n  .cfi_restore x22\n  .cfi_restore x23\n  .cfi_restore x24");
+	asm("  .cfi_restore x25\n  .cfi_restore x26\n  .cfi_restore x27\n  .cfi_restore x28\n  .cfi_restore x29");
+	asm("  .cfi_restore d8\n  .cfi_restore d9\n  .cfi_restore d10\n  .cfi_restore d11");
+	asm("  .cfi_restore d12\n  .cfi_restore d13\n  .cfi_restore d14\n  .cfi_restore d15");
+	// Build the (unlinked) base frame described in _tina_base_frame().
+	asm("  sub x4, sp, #8");
+	asm("  stp xzr, x4, [sp, #-16]!");
+	asm("  stp xzr, xzr, [sp, #-16]!");
+	asm("  mov x29, sp");
+	asm(_TINA_CFI_BASE_FRAME);
+	asm("  bl " _TINA_SYMBOL(_tina_context));
+	asm("  brk #0");
+	asm("  .cfi_endproc");
 
 	asm(_TINA_SYMBOL(_tina_swap:));
+	asm("  .cfi_startproc");
 	asm("  sub sp, sp, 0xA0");
+	asm("  .cfi_def_cfa_offset 0xA0");
 	asm("  stp x19, x20, [sp, 0x00]");
 	asm("  stp x21, x22, [sp, 0x10]");
 	asm("  stp x23, x24, [sp, 0x20]");
@@ -362,8 +533,10 @@ uintptr_t tina_yield(tina* coro, uintptr_t value){
 	asm("  stp d10, d11, [sp, 0x70]");
 	asm("  stp d12, d13, [sp, 0x80]");
 	asm("  stp d14, d15, [sp, 0x90]");
+	_TINA_CFI_SAVED();
 	asm("  mov x3, sp");
 	asm("  str x3, [x0]");
+	asm(_TINA_SYMBOL(_tina_swap_resume:));
 	asm("  ldr x3, [x1]");
 	asm("  mov sp, x3");
 	asm("  ldp x19, x20, [sp, 0x00]");
@@ -377,8 +550,10 @@ uintptr_t tina_yield(tina* coro, uintptr_t value){
 	asm("  ldp d12, d13, [sp, 0x80]");
 	asm("  ldp d14, d15, [sp, 0x90]");
 	asm("  add sp, sp, 0xA0");
+	asm("  .cfi_def_cfa_offset 0");
 	asm("  mov x0, x2");
 	asm("  ret");
+	asm("  .cfi_endproc");
 #endif
 
 #endif // TINA_IMPLEMENTATION
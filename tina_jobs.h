@@ -48,15 +48,39 @@ typedef struct {
 	void* user_data;
 	// User defined job index. (optional, useful for parallel-for constructs)
 	uintptr_t user_idx;
-	// Index of the queue to run the job on.
+	// Index of the queue to run the job on, or TINA_WORKER_QUEUE() to run it on a specific worker.
 	unsigned queue_idx;
 } tina_job_description;
 
+// Flag for queue indexes that refer to a worker's private queue instead of a scheduler queue.
+#define TINA_WORKER_QUEUE_FLAG 0x80000000u
+// Queue index for the private queue of a worker. (See tina_worker_index())
+// Jobs in it only run on that worker's thread, which checks it before the queue it's running.
+// Ex: tina_job_switch_queue(job, TINA_WORKER_QUEUE(idx)) to hop back to the worker a job started on.
+#define TINA_WORKER_QUEUE(_WORKER_IDX_) (TINA_WORKER_QUEUE_FLAG | (_WORKER_IDX_))
+
 // Get the scheduler for a job.
 tina_scheduler* tina_job_get_scheduler(tina_job* job);
 // Get the description for a job.
 const tina_job_description* tina_job_get_description(tina_job* job);
 
+// Get the job running on the calling thread, or NULL if the thread isn't running a job.
+// Useful to wait or yield from deep inside library code without passing the job around.
+tina_job* tina_job_current(void);
+// Get the index of the calling thread's worker in a scheduler it's running jobs for. It's less than tina_worker_count().
+// A thread keeps it's index while it's in tina_scheduler_run(), and gets the same one back next time unless it was given away.
+// Indexes are only given to other threads once all TINA_MAX_WORKERS have been used, so threads can come and go freely.
+// Note: A job that waits or yields may be resumed on a different worker, so call this again afterwards.
+unsigned tina_worker_index(tina_scheduler* sched);
+// Get the number of worker indexes that have been used so far. It never decreases. (Never more than TINA_MAX_WORKERS)
+// Note: Jobs can be queued for a worker that hasn't started yet. They will run once it calls tina_scheduler_run().
+unsigned tina_worker_count(tina_scheduler* sched);
+// Set the NUMA node of the calling thread. Call it before the thread first runs or enqueues jobs for a NUMA scheduler.
+// Otherwise the node of the CPU the thread is running on is used. (Linux only, other OSes use node 0)
+void tina_worker_set_node(unsigned node);
+// Get the NUMA node the calling thread's worker takes jobs from first. Always 0 for schedulers with a single node.
+unsigned tina_worker_node(void);
+
 // Counter used to signal when a group of jobs is done.
 // Note: Must be zero-initialized before use.
 typedef struct {
@@ -79,6 +103,34 @@ tina_scheduler* tina_scheduler_new(unsigned job_count, unsigned queue_count, uns
 void tina_scheduler_free(tina_scheduler* sched);
 #endif
 
+#ifndef TINA_MAX_WORKERS
+// Maximum number of threads that can run jobs from a single scheduler at once.
+#define TINA_MAX_WORKERS 64
+#endif
+
+#ifndef _TINA_CACHE_LINE
+// Size to pad per-worker data to, so workers don't write to the same cache lines. Must be a power of two.
+#define _TINA_CACHE_LINE 64
+#endif
+
+#ifndef TINA_MAX_NUMA_NODES
+// Maximum number of NUMA nodes a scheduler can be split across.
+#define TINA_MAX_NUMA_NODES 8
+#endif
+
+// NUMA aware versions of the functions above. The jobs, fibers and queues are split evenly into 'node_count' shards.
+// Each node's jobs and fiber stacks are bound to it's memory, and workers run jobs from their own node before stealing from others.
+// Jobs are queued on the node of the thread that enqueued them, and resume on the node of their fiber's stack.
+// A 'node_count' of 1 is the same as using the regular functions.
+size_t tina_scheduler_size_numa(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count);
+tina_scheduler* tina_scheduler_init_numa(void* buffer, unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count);
+
+#ifndef TINA_NO_CRT
+tina_scheduler* tina_scheduler_new_numa(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count);
+// Get the number of NUMA nodes from /sys/devices/system/node, or 1 if it's not available.
+unsigned tina_numa_node_count(void);
+#endif
+
 // Link a pair of queues for job prioritization. When the 'queue_idx' is empty it will steal jobs from 'fallback_idx'.
 void tina_scheduler_queue_priority(tina_scheduler* sched, unsigned queue_idx, unsigned fallback_idx);
 
@@ -86,20 +138,77 @@ typedef enum {
 	TINA_RUN_LOOP, // Run jobs from a queue until tina_scheduler_interrupt() is called.
 	TINA_RUN_FLUSH, // Run jobs from a queue until empty, or until all remaing jobs are waiting.
 	TINA_RUN_SINGLE, // Run a single non-waiting job from a queue.
+	TINA_RUN_UNTIL_GROUP, // Run jobs from a queue until a group reaches a threshold, or until tina_scheduler_interrupt() is called.
+	TINA_RUN_BUDGET, // Run jobs from a queue until empty, or until a time or job count budget is used up.
 } tina_run_mode;
 
+// Limits for the modes that need them. Use with tina_scheduler_run_limited().
+typedef struct {
+	// TINA_RUN_UNTIL_GROUP: Run until 'group' has 'threshold' or fewer remaining jobs.
+	tina_group* group;
+	unsigned threshold;
+	// TINA_RUN_BUDGET: Stop after running jobs for 'nanoseconds', or after running 'max_jobs'. Zero means no limit.
+	// Jobs aren't preempted, so the time budget can be overrun by the last job.
+	// With TINA_NO_CRT, a time budget requires overriding _TINA_TIMESTAMP() in the implementation.
+	uint64_t nanoseconds;
+	unsigned max_jobs;
+} tina_run_limits;
+
 // Run jobs in the given queue based on the mode, returns false if no jobs were run.
 bool tina_scheduler_run(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode);
+// Like tina_scheduler_run(), but required for TINA_RUN_UNTIL_GROUP and TINA_RUN_BUDGET. 'limits' is ignored by the other modes.
+// Ex: Upload textures for up to 2 ms each frame on the main thread: {.nanoseconds = 2000000}
+bool tina_scheduler_run_limited(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode, const tina_run_limits* limits);
 // Interrupt TINA_RUN_LOOP execution of a queue on all active threads as soon as their current jobs finish.
 void tina_scheduler_interrupt(tina_scheduler* sched, unsigned queue_idx);
 
+// Define TINA_JOBS_NO_WORKERS to leave out the worker pool, along with it's threading, pinning and CPU topology code.
+#if !defined(TINA_NO_CRT) && !defined(TINA_JOBS_NO_WORKERS)
+typedef enum {
+	// Don't pin worker threads, let the OS schedule them.
+	TINA_AFFINITY_NONE,
+	// Pin workers to neighboring CPUs, filling each core's SMT siblings first. Good when workers share data.
+	TINA_AFFINITY_COMPACT,
+	// Spread workers across packages and cores before doubling up on SMT siblings. Good for memory bandwidth.
+	TINA_AFFINITY_SCATTER,
+	// Pin one worker to each physical core, skipping SMT siblings. Good for cache heavy jobs.
+	TINA_AFFINITY_PHYSICAL,
+} tina_affinity;
+
+// Opaque type for a pool of worker threads.
+typedef struct tina_workers tina_workers;
+
+// Start 'count' threads that run 'queue_idx' with TINA_RUN_LOOP. If 'count' is 0, start one per CPU. (or per physical core for TINA_AFFINITY_PHYSICAL)
+// The count is clamped so all of the scheduler's pools leave one of the TINA_MAX_WORKERS for the thread that started them.
+// Returns NULL if no threads could be started, and fewer threads are started if creating one fails. Check tina_workers_count().
+// Threads are named 'name' followed by their index (ex: "tina-worker3" in top -H), 'name' is optional and truncated to fit.
+// CPU topology is read from /sys/devices/system/cpu, pinning and naming are only supported on Linux. Other OSes ignore 'affinity'.
+// Pinned threads use the NUMA node of their CPU with tina_worker_set_node().
+tina_workers* tina_workers_start(tina_scheduler* sched, unsigned queue_idx, unsigned count, tina_affinity affinity, const char* name);
+// Get the number of CPUs detected for an affinity. (or physical cores for TINA_AFFINITY_PHYSICAL) This is the count tina_workers_start() uses for 0 before clamping it.
+unsigned tina_workers_cpu_count(tina_affinity affinity);
+// Get the number of threads in the pool.
+unsigned tina_workers_count(tina_workers* workers);
+// Get the CPU a thread in the pool was pinned to, or -1 if it wasn't pinned.
+int tina_workers_cpu(tina_workers* workers, unsigned idx);
+// Interrupt the pool's queue, wait for the threads to finish their current jobs and exit, then free the pool.
+void tina_workers_stop(tina_workers* workers);
+#endif
+
 // Add jobs to the scheduler, optionally pass the address of a tina_group to track when the jobs have completed.
 // If 'max_group_count' is non-zero, then 'count' will be adjusted based on the number of jobs already in the group.
 // Returns the number of jobs added.
 unsigned tina_scheduler_enqueue_batch(tina_scheduler* sched, const tina_job_description* list, unsigned count, tina_group* group, unsigned max_group_count);
 // Yield the current job until the group has 'threshold' or fewer remaining jobs.
 // 'threshold' is useful to throttle a producer job. Allowing it to keep a consumers busy without a lot of queued items.
+// When a job that completes releases the waiter, it runs next on the same worker if the worker is running it's queue.
 unsigned tina_job_wait(tina_job* job, tina_group* group, unsigned threshold);
+// Like tina_job_wait(), but the worker runs other jobs inline until the group reaches 'threshold', and only suspends if it runs out.
+// It runs the newest queued job in the group first, otherwise the next job it would have run from the queue it's running.
+// Unrelated jobs are only run until the nesting gets too deep (_TINA_HELP_DEPTH), after that only the group's jobs are helped.
+// Recursive fork-join then runs depth first, using a few fibers per worker instead of one per waiting job.
+// Note: Only jobs in the queue the worker is running, or it's fallbacks, are helped. Jobs in other queues are left alone.
+unsigned tina_job_wait_help(tina_job* job, tina_group* group, unsigned threshold);
 // Yield the current job and reschedule at the back of the queue.
 void tina_job_yield(tina_job* job);
 // Yield the current job and reschedule it at the back of a different queue.
@@ -111,6 +220,276 @@ unsigned tina_job_switch_queue(tina_job* job, unsigned queue_idx);
 unsigned tina_group_increment(tina_scheduler* scheduler, tina_group* group, unsigned count, unsigned max_count);
 // Decrement a group's value directly to manually mark completion of some work.
 void tina_group_decrement(tina_scheduler* scheduler, tina_group* group, unsigned count);
+// Enqueue a job once the group has 'threshold' or fewer remaining jobs. It's enqueued immediately if it already does.
+// Unlike a job waiting in tina_job_wait(), a continuation only takes a job from the pool and doesn't get a fiber until it runs.
+void tina_group_then(tina_scheduler* sched, tina_group* group, unsigned threshold, const tina_job_description* desc);
+
+// A value that one job provides and other jobs wait for.
+// Note: Must be zero-initialized before use, and can only be fulfilled once.
+typedef struct {
+	// Private:
+	tina_group _group;
+	uintptr_t _value;
+	unsigned _ready, _remaining;
+} tina_future;
+
+// Set the value of a future and resume the jobs awaiting it.
+void tina_future_fulfill(tina_scheduler* sched, tina_future* future, uintptr_t value);
+// Check if a future has been fulfilled.
+bool tina_future_ready(tina_future* future);
+// Get the value of a future. The job is only suspended if the future hasn't been fulfilled yet.
+// Reading a fulfilled future is a single atomic load, it doesn't take the scheduler lock.
+uintptr_t tina_future_await(tina_job* job, tina_future* future);
+// Fulfill 'out' with 'count' once all of the futures have been fulfilled.
+// Each future still pending gets a tina_group_then() continuation on 'queue_idx' that counts it down, so nothing polls.
+void tina_future_when_all(tina_scheduler* sched, tina_future* out, tina_future* const futures[], unsigned count, unsigned queue_idx);
+// Fulfill 'out' with the index of the first of the futures to be fulfilled.
+// Note: The continuations for the other futures hold a job each until those are fulfilled too, and 'out' must outlive them.
+void tina_future_when_any(tina_scheduler* sched, tina_future* out, tina_future* const futures[], unsigned count, unsigned queue_idx);
+
+// Pass as the queue to tina_group_wait_blocking() to sleep without running jobs.
+#define TINA_NO_QUEUE (~0u)
+// Block the calling thread until the group has 'threshold' or fewer remaining jobs. Returns the group's count.
+// Unlike tina_job_wait(), this is for threads that aren't running a job, such as the main thread during shutdown.
+// While waiting it runs jobs from 'queue_idx' like tina_scheduler_run(), or just sleeps if it's TINA_NO_QUEUE.
+unsigned tina_group_wait_blocking(tina_scheduler* sched, tina_group* group, unsigned threshold, unsigned queue_idx);
+
+// Parallel-for body prototype. Called with sub-ranges [begin, end) of the loop that are at most 'grain' long.
+typedef void tina_for_func(tina_job* job, void* ctx, size_t begin, size_t end);
+// Run 'func' over [begin, end) in chunks of 'grain' using a single job on 'queue_idx'. Wait on 'group' for the loop to finish.
+// Between chunks, the job splits off the upper half of it's remaining range if threads running the queue are idle.
+// The number of jobs adapts to the load instead of being fixed up front, and never uses more jobs than are free.
+// Note: Checking for idle threads takes the scheduler lock, so make 'grain' large enough to amortize it.
+void tina_parallel_for(tina_scheduler* sched, size_t begin, size_t end, size_t grain, tina_for_func* func, void* ctx, unsigned queue_idx, tina_group* group);
+
+// Fold the elements in [begin, end) into the accumulator 'acc'.
+typedef void tina_fold_func(void* ctx, void* acc, size_t begin, size_t end);
+// Combine the accumulator 'src' into 'dst'. (ex: *dst += *src)
+typedef void tina_combine_func(void* ctx, void* dst, const void* src);
+
+typedef struct {
+	// Folds a range of elements into an accumulator.
+	tina_fold_func* fold;
+	// Combines two accumulators. Must be associative, and also commutative for tina_parallel_reduce().
+	tina_combine_func* combine;
+	// Writes the prefixes for a range of elements starting from 'acc'. Inclusive or exclusive is up to you. (tina_parallel_scan() only)
+	tina_fold_func* scan;
+	// Accumulator that leaves others unchanged when combined with them. (ex: 0 for a sum)
+	const void* identity;
+	// Size of an accumulator in bytes.
+	size_t value_size;
+	// User defined context pointer passed to the functions. (optional)
+	void* ctx;
+} tina_reduce_description;
+
+// Get the size of the scratch buffer tina_parallel_reduce() and tina_parallel_scan() need for an accumulator size.
+// It holds a cache line padded accumulator for each worker, so workers never write to the same cache lines.
+size_t tina_parallel_scratch_size(size_t value_size);
+// Reduce [begin, end) into 'result' with a tina_parallel_for() of 'grain' sized chunks on 'queue_idx', and wait for it.
+// Each worker folds it's chunks into it's own accumulator in 'scratch', and the accumulators are combined as a tree in parallel.
+// Must be called from a job, which helps run the chunks while waiting. 'fold' and 'combine' must not wait or yield.
+void tina_parallel_reduce(tina_job* job, const tina_reduce_description* desc, size_t begin, size_t end, size_t grain, unsigned queue_idx, void* scratch, void* result);
+// Two pass prefix-scan of [begin, end) split into at most TINA_MAX_WORKERS blocks of at least 'grain' elements.
+// The first pass folds the blocks in parallel. After scanning the block totals, the second pass runs 'scan' on each block in parallel.
+// Copies the total of all the elements to 'result' if it's not NULL. Same rules as tina_parallel_reduce() otherwise.
+void tina_parallel_scan(tina_job* job, const tina_reduce_description* desc, size_t begin, size_t end, size_t grain, unsigned queue_idx, void* scratch, void* result);
+
+// Mutex for jobs. A job that can't lock it is suspended, so the worker thread can run other jobs instead of blocking.
+// Note: Must be zero-initialized before use.
+typedef struct {
+	// Private:
+	unsigned _state;
+	tina_job* _wait_head;
+	tina_job* _wait_tail;
+} tina_job_mutex;
+
+// Lock a mutex. If it's held, spin briefly and then suspend the job until the lock is handed to it.
+void tina_job_mutex_lock(tina_job* job, tina_job_mutex* mutex);
+// Lock a mutex if it's not held. Returns true if it was locked.
+bool tina_job_mutex_try_lock(tina_job_mutex* mutex);
+// Unlock a mutex. If jobs are waiting for it, the lock is handed directly to the one that has waited longest.
+void tina_job_mutex_unlock(tina_job* job, tina_job_mutex* mutex);
+
+// Reader-writer lock for jobs, with writer preference. Jobs that can't lock it are suspended like with tina_job_mutex.
+// Readers only touch their worker's own counter unless a writer holds or is waiting for the lock.
+// Note: Must be zero-initialized before use. It's padded to a cache line per worker, so it's not small.
+typedef struct {
+	// Private:
+	unsigned _writers;
+	bool _writing;
+	tina_job* _read_head;
+	tina_job* _read_tail;
+	tina_job* _write_head;
+	tina_job* _write_tail;
+	unsigned char _pad[_TINA_CACHE_LINE];
+	// Only the sum of the counters is meaningful, since a job can unlock on a different worker than it locked on.
+	// The extra counter is shared by threads that don't have a worker in the job's scheduler.
+	struct {unsigned count; unsigned char _pad[_TINA_CACHE_LINE - sizeof(unsigned)];} _readers[TINA_MAX_WORKERS + 1];
+} tina_job_rwlock;
+
+// Lock for reading. Suspends the job while a writer holds the lock or is waiting for it.
+void tina_job_rwlock_read_lock(tina_job* job, tina_job_rwlock* rwlock);
+// Unlock after reading. The last reader to leave hands the lock to a waiting writer.
+void tina_job_rwlock_read_unlock(tina_job* job, tina_job_rwlock* rwlock);
+// Lock for writing. Suspends the job until the current writer and readers are done.
+void tina_job_rwlock_write_lock(tina_job* job, tina_job_rwlock* rwlock);
+// Unlock after writing. Hands the lock to the next waiting writer if there is one, otherwise wakes all the waiting readers.
+void tina_job_rwlock_write_unlock(tina_job* job, tina_job_rwlock* rwlock);
+
+// Counting semaphore for jobs. Limits how many jobs use a resource at once by suspending the ones that can't get enough permits.
+// Waiters are served strictly in order, so a job asking for many permits isn't starved by ones asking for few.
+typedef struct {
+	// Private:
+	unsigned _permits;
+	tina_job* _wait_head;
+	tina_job* _wait_tail;
+} tina_job_semaphore;
+
+// Initialize a semaphore with the number of available permits.
+void tina_job_semaphore_init(tina_job_semaphore* sem, unsigned permits);
+// Take 'count' permits, suspending the job until they are available.
+void tina_job_semaphore_acquire(tina_job* job, tina_job_semaphore* sem, unsigned count);
+// Take 'count' permits if they are available and no jobs are waiting. Returns true if they were taken.
+bool tina_job_semaphore_try_acquire(tina_job_semaphore* sem, unsigned count);
+// Return 'count' permits. Waiting jobs that can now take theirs are pushed to the back of their queues.
+// Safe to call from any thread, not just from jobs.
+void tina_job_semaphore_release(tina_scheduler* sched, tina_job_semaphore* sem, unsigned count);
+
+// Opaque type for a bounded multi-producer, multi-consumer queue of fixed size elements for passing data between jobs.
+// Jobs are suspended when sending to a full channel or receiving from an empty one, so the worker can run other jobs.
+typedef struct tina_channel tina_channel;
+
+// Get the size of the memory needed for a channel.
+size_t tina_channel_size(size_t element_size, size_t capacity);
+// Initialize a channel into a buffer.
+tina_channel* tina_channel_init(void* buffer, size_t element_size, size_t capacity);
+// Destroy a channel. No jobs can be waiting on it.
+void tina_channel_destroy(tina_channel* chan);
+
+#ifndef TINA_NO_CRT
+// Convenience constructor. Allocate and initialize a channel.
+tina_channel* tina_channel_new(size_t element_size, size_t capacity);
+// Convenience destructor. Destroy and free a channel.
+void tina_channel_free(tina_channel* chan);
+#endif
+
+// Send 'count' elements, suspending the job whenever the channel is full. Returns the number sent, which is less than 'count' only if the channel was closed.
+size_t tina_channel_send(tina_job* job, tina_channel* chan, const void* elements, size_t count);
+// Receive up to 'count' elements, suspending the job while the channel is empty. Returns the number received.
+// Returns 0 only once the channel has been closed and all of it's elements have been received. 'count' must not be 0.
+size_t tina_channel_recv(tina_job* job, tina_channel* chan, void* elements, size_t count);
+// Send as many of the elements as fit without waiting. Returns the number sent. Safe to call from any thread, not just from jobs.
+size_t tina_channel_try_send(tina_scheduler* sched, tina_channel* chan, const void* elements, size_t count);
+// Receive up to 'count' elements without waiting. Returns the number received. Safe to call from any thread, not just from jobs.
+size_t tina_channel_try_recv(tina_scheduler* sched, tina_channel* chan, void* elements, size_t count);
+// Close a channel. Sending to it fails, and waiting jobs are woken. Elements already sent can still be received.
+void tina_channel_close(tina_scheduler* sched, tina_channel* chan);
+
+// Opaque type for a reusable graph of jobs and the dependencies between them.
+typedef struct tina_graph tina_graph;
+
+// Get the size of the memory needed for a graph.
+size_t tina_graph_size(unsigned node_capacity, unsigned edge_capacity);
+// Initialize a graph into a buffer.
+tina_graph* tina_graph_init(void* buffer, unsigned node_capacity, unsigned edge_capacity);
+
+#ifndef TINA_NO_CRT
+// Convenience constructor. Allocate and initialize a graph.
+tina_graph* tina_graph_new(unsigned node_capacity, unsigned edge_capacity);
+// Free a graph created using tina_graph_new().
+void tina_graph_free(tina_graph* graph);
+#endif
+
+// Add a node that runs a job once all of it's predecessors have completed. Returns the index of the node.
+unsigned tina_graph_add_node(tina_graph* graph, const tina_job_description* desc);
+// Add an edge so that node 'to' doesn't start until node 'from' has completed. The graph must not have cycles. (checked by an assertion in tina_graph_launch())
+void tina_graph_add_edge(tina_graph* graph, unsigned from, unsigned to);
+// Enqueue the nodes without predecessors. As each node completes, it enqueues the successors that have nothing left to wait for.
+// Dependencies are counted instead of waited on, so no fibers are used by nodes that haven't started.
+// 'group' is optional. It's incremented by the number of nodes, and each node decrements it when it completes.
+// A graph can be launched again once it has completed, but it must not be modified or launched while it's running.
+void tina_graph_launch(tina_scheduler* sched, tina_graph* graph, tina_group* group);
+
+// Latency histograms are log-linear (HDR style) with 1/16th precision for values up to ~18 minutes in nanoseconds.
+#define TINA_HISTOGRAM_SUB_BITS 4
+#define TINA_HISTOGRAM_MAX_BITS 40
+#define TINA_HISTOGRAM_BUCKETS ((TINA_HISTOGRAM_MAX_BITS - TINA_HISTOGRAM_SUB_BITS + 1) << TINA_HISTOGRAM_SUB_BITS)
+
+typedef struct {
+	// Number of samples, and the total/min/max of their values.
+	uint64_t count, total, min, max;
+	uint64_t buckets[TINA_HISTOGRAM_BUCKETS];
+} tina_histogram;
+
+// Get the value that 'percentile' percent (0-100) of the samples are less than or equal to.
+uint64_t tina_histogram_percentile(const tina_histogram* hist, double percentile);
+
+typedef struct {
+	// Nanoseconds jobs sat in the queue after being enqueued or yielding until they started running.
+	tina_histogram queued;
+	// Nanoseconds jobs were suspended in tina_job_wait() until their group released them.
+	tina_histogram suspended;
+	// Nanoseconds from a job being released from a group's wait list until it ran again.
+	tina_histogram wake;
+} tina_queue_latency;
+
+// Copy the latency histograms for a queue, and optionally reset them. Jobs in worker queues aren't recorded.
+// Define TINA_JOBS_LATENCY when compiling the implementation to enable timestamping, otherwise the histograms are empty.
+void tina_scheduler_latency(tina_scheduler* sched, unsigned queue_idx, tina_queue_latency* latency, bool reset);
+
+typedef struct {
+	// Number of jobs that ran to completion, and how many times jobs yielded, waited or switched queues.
+	uint64_t jobs_run, yields, waits, queue_switches;
+	// Number of times the scheduler lock was acquired, and how many of those had to wait for another thread.
+	uint64_t lock_acquisitions, lock_contended;
+} tina_worker_stats;
+
+typedef struct {
+	// Capacity of the job and fiber pools, how many are currently free, and the most that have been in use at once.
+	unsigned job_count, jobs_free, jobs_high_water;
+	unsigned fiber_count, fibers_free, fibers_high_water;
+	// Number of jobs in all queues including worker queues, and the number of jobs waiting on groups, locks or channels. (including continuations)
+	unsigned jobs_queued, jobs_waiting;
+	// Number of worker indexes used so far, and how many threads are currently sleeping while waiting for work.
+	unsigned workers, workers_parked;
+	// Counters summed for all threads, and counters for each worker.
+	// Define TINA_JOBS_STATS when compiling the implementation to enable these, otherwise they are zero.
+	tina_worker_stats total, worker[TINA_MAX_WORKERS];
+} tina_stats;
+
+// Take a snapshot of the scheduler's state and counters.
+// 'queue_lengths' is optional, and if provided receives the number of jobs currently in each queue.
+void tina_scheduler_stats(tina_scheduler* sched, tina_stats* stats, unsigned* queue_lengths);
+
+typedef struct {
+	const char* name;
+	// Number of jobs with this name that completed, and the number of times they were suspended by yielding or waiting.
+	uint64_t run_count, suspend_count;
+	// Total nanoseconds the jobs spent running on a worker, and total nanoseconds from being enqueued until they completed.
+	uint64_t cpu_time, wall_time;
+} tina_name_stats;
+
+// Copy up to 'max' entries of per job name accounting, and optionally reset the counters. Returns the number of entries copied.
+// Names are interned by their contents, and must remain valid for the lifetime of the scheduler. (ex: string literals)
+// Define TINA_JOBS_NAME_STATS when compiling the implementation to enable this, otherwise no entries are returned.
+unsigned tina_scheduler_name_stats(tina_scheduler* sched, tina_name_stats* stats, unsigned max, bool reset);
+
+#ifndef TINA_NO_CRT
+// Write the recorded trace events to a file in the Chrome trace event JSON format, and clear them.
+// Open the file with chrome://tracing or https://ui.perfetto.dev. Returns false if the file couldn't be written.
+// Define TINA_JOBS_TRACE when compiling the implementation to enable tracing, otherwise the trace will be empty.
+// Events keep a copy of the job's name truncated to 31 characters, so names don't need to outlive their jobs.
+// Each time a job runs it records a single slice ending with how it stopped: completed, yielded, waiting or switched queues.
+// There are no separate begin/end events, and workers append them to their ring buffer while holding the scheduler lock instead of lock-free.
+// The lock is already held to finish running the job, so the only extra cost is copying the name.
+bool tina_scheduler_trace_flush(tina_scheduler* sched, const char* filename);
+
+// Write the time jobs spent suspended, aggregated by job name and the call stack where they yielded or waited, and clear it.
+// The output uses the folded stack format read by flamegraph.pl and speedscope. Values are in nanoseconds.
+// Define TINA_JOBS_OFFCPU when compiling the implementation to enable this, otherwise the output will be empty.
+// Stacks are captured by walking frame pointers, so compile with -fno-omit-frame-pointer. (GCC/Clang only)
+bool tina_scheduler_offcpu_flush(tina_scheduler* sched, const char* filename);
+#endif
 
 // Convenience method. Enqueue a single job.
 static inline void tina_scheduler_enqueue(tina_scheduler* sched, const char* name, tina_job_func* func, void* user_data, uintptr_t user_idx, unsigned queue_idx, tina_group* group){
@@ -136,18 +515,323 @@ static inline void tina_scheduler_enqueue(tina_scheduler* sched, const char* nam
 #define _TINA_COND_BROADCAST(_SIG_) cnd_broadcast(&_SIG_)
 #endif
 
+#ifndef _TINA_ATOMIC_LOAD
+// Override these to use your own atomics. Acquire and release ordering is all that's needed.
+// Only used on unsigned values. CAS returns true if the swap happened, and exchange returns the old value.
+// Add returns the new value, and must be a full barrier. (tina_job_rwlock relies on it for store-load ordering)
+#if _MSC_VER
+	#include <intrin.h>
+	// Don't rely on volatile for ordering, /volatile:iso is the default on ARM and it's an option on x86.
+	#if _M_ARM64
+		#define _TINA_ATOMIC_LOAD(_PTR_) ((unsigned)__ldar32((volatile unsigned __int32*)(_PTR_)))
+		#define _TINA_ATOMIC_STORE(_PTR_, _VALUE_) __stlr32((volatile unsigned __int32*)(_PTR_), (unsigned __int32)(_VALUE_))
+		#define _TINA_SPIN_PAUSE() __yield()
+	#elif _M_ARM
+		static inline unsigned _tina_atomic_load(const unsigned* ptr){
+			unsigned value = (unsigned)__iso_volatile_load32((const volatile __int32*)ptr);
+			__dmb(_ARM_BARRIER_ISH);
+			return value;
+		}
+		static inline void _tina_atomic_store(unsigned* ptr, unsigned value){
+			__dmb(_ARM_BARRIER_ISH);
+			__iso_volatile_store32((volatile __int32*)ptr, (__int32)value);
+		}
+		#define _TINA_ATOMIC_LOAD(_PTR_) _tina_atomic_load(_PTR_)
+		#define _TINA_ATOMIC_STORE(_PTR_, _VALUE_) _tina_atomic_store(_PTR_, _VALUE_)
+		#define _TINA_SPIN_PAUSE() __yield()
+	#else
+		// Plain x86 loads and stores are already acquire/release, so only the compiler needs to be kept from reordering them.
+		static inline unsigned _tina_atomic_load(const unsigned* ptr){
+			unsigned value = *(const volatile unsigned*)ptr;
+			_ReadWriteBarrier();
+			return value;
+		}
+		static inline void _tina_atomic_store(unsigned* ptr, unsigned value){
+			_ReadWriteBarrier();
+			*(volatile unsigned*)ptr = value;
+		}
+		#define _TINA_ATOMIC_LOAD(_PTR_) _tina_atomic_load(_PTR_)
+		#define _TINA_ATOMIC_STORE(_PTR_, _VALUE_) _tina_atomic_store(_PTR_, _VALUE_)
+		#define _TINA_SPIN_PAUSE() _mm_pause()
+	#endif
+	#define _TINA_ATOMIC_CAS(_PTR_, _EXPECTED_, _DESIRED_) (_InterlockedCompareExchange((volatile long*)(_PTR_), (long)(_DESIRED_), (long)(_EXPECTED_)) == (long)(_EXPECTED_))
+	#define _TINA_ATOMIC_EXCHANGE(_PTR_, _VALUE_) ((unsigned)_InterlockedExchange((volatile long*)(_PTR_), (long)(_VALUE_)))
+	#define _TINA_ATOMIC_ADD(_PTR_, _VALUE_) ((unsigned)_InterlockedExchangeAdd((volatile long*)(_PTR_), (long)(_VALUE_)) + (unsigned)(_VALUE_))
+#else
+	#define _TINA_ATOMIC_LOAD(_PTR_) __atomic_load_n(_PTR_, __ATOMIC_ACQUIRE)
+	#define _TINA_ATOMIC_STORE(_PTR_, _VALUE_) __atomic_store_n(_PTR_, _VALUE_, __ATOMIC_RELEASE)
+	#define _TINA_ATOMIC_CAS(_PTR_, _EXPECTED_, _DESIRED_) _tina_atomic_cas(_PTR_, _EXPECTED_, _DESIRED_)
+	#define _TINA_ATOMIC_EXCHANGE(_PTR_, _VALUE_) __atomic_exchange_n(_PTR_, _VALUE_, __ATOMIC_ACQ_REL)
+	#define _TINA_ATOMIC_ADD(_PTR_, _VALUE_) __atomic_add_fetch(_PTR_, _VALUE_, __ATOMIC_SEQ_CST)
+	static inline bool _tina_atomic_cas(unsigned* ptr, unsigned expected, unsigned desired){
+		return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	}
+	#if __x86_64__ || __i386__
+		#define _TINA_SPIN_PAUSE() __builtin_ia32_pause()
+	#elif __aarch64__ || __arm__
+		#define _TINA_SPIN_PAUSE() __asm__ __volatile__("yield")
+	#else
+		#define _TINA_SPIN_PAUSE()
+	#endif
+#endif
+#endif
+
+#ifndef _TINA_JOB_MUTEX_SPIN
+// Number of times to check a held tina_job_mutex before suspending the job.
+#define _TINA_JOB_MUTEX_SPIN 64
+#endif
+
+#ifndef _TINA_HELP_DEPTH
+// How deep tina_job_wait_help() can nest unrelated jobs on a worker. A waiter can't resume until every job nested above it finishes.
+#define _TINA_HELP_DEPTH 4
+#endif
+
+// Only used by the worker pool. Define TINA_JOBS_NO_WORKERS instead of overriding these if you don't need it.
+#if !defined(TINA_NO_CRT) && !defined(TINA_JOBS_NO_WORKERS)
+#ifndef _TINA_THREAD_T
+#define _TINA_THREAD_T thrd_t
+// Must evaluate to true if the thread was created.
+#define _TINA_THREAD_CREATE(_THREAD_, _FUNC_, _ARG_) (thrd_create(&_THREAD_, _FUNC_, _ARG_) == thrd_success)
+#define _TINA_THREAD_JOIN(_THREAD_) thrd_join(_THREAD_, NULL)
+#endif
+
+#ifndef _TINA_MAX_CPUS
+// Maximum number of CPUs a worker pool can be pinned to.
+#define _TINA_MAX_CPUS 1024
+#endif
+
+#ifndef _TINA_THREAD_PIN
+	#if __linux__
+		#include <unistd.h>
+		#include <sys/syscall.h>
+		#include <sys/prctl.h>
+		// Pin the calling thread to a CPU, and set the calling thread's name.
+		#define _TINA_THREAD_PIN(_CPU_) _tina_thread_pin(_CPU_)
+		#define _TINA_THREAD_NAME(_NAME_) prctl(PR_SET_NAME, _NAME_, 0, 0, 0)
+		
+		static void _tina_thread_pin(int cpu){
+			enum {BITS = 8*sizeof(unsigned long)};
+			unsigned long mask[_TINA_MAX_CPUS/BITS] = {0};
+			mask[cpu/BITS] = 1ul << (cpu%BITS);
+			// Ignore errors. The CPU may have gone offline, or be excluded by a cgroup.
+			syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+		}
+	#else
+		#define _TINA_THREAD_PIN(_CPU_) ((void)(_CPU_))
+		#define _TINA_THREAD_NAME(_NAME_) ((void)(_NAME_))
+	#endif
+#endif
+
+#ifndef _TINA_CPU_COUNT
+	#if defined(__unix__) || defined(__APPLE__)
+		#include <unistd.h>
+		// Number of CPUs to use when the topology can't be read.
+		#define _TINA_CPU_COUNT() ((unsigned)sysconf(_SC_NPROCESSORS_ONLN))
+	#else
+		#define _TINA_CPU_COUNT() 1u
+	#endif
+#endif
+
+#ifndef _TINA_SYSFS_CPU
+// Where to read the CPU topology from. Override this to test with a fake topology.
+#define _TINA_SYSFS_CPU "/sys/devices/system/cpu"
+#endif
+#endif
+
+#ifndef _TINA_SYSFS_NODE
+// Where to read the NUMA topology from.
+#define _TINA_SYSFS_NODE "/sys/devices/system/node"
+#endif
+
+#ifndef _TINA_PAGE_SIZE
+// Each node's jobs and fibers are aligned to this so they can be bound separately.
+#define _TINA_PAGE_SIZE 4096
+#endif
+
+#ifndef _TINA_NUMA_BIND
+	#if __linux__ && !defined(TINA_NO_CRT)
+		#include <unistd.h>
+		#include <sys/syscall.h>
+		// Prefer placing a page aligned range of memory on a NUMA node, and get the node of the CPU the calling thread is on.
+		#define _TINA_NUMA_BIND(_PTR_, _SIZE_, _NODE_) _tina_numa_bind(_PTR_, _SIZE_, _NODE_)
+		#define _TINA_CURRENT_NODE() _tina_current_node()
+		
+		static void _tina_numa_bind(void* ptr, size_t size, unsigned node){
+			enum {BITS = 8*sizeof(unsigned long), MPOL_PREFERRED_ = 1, MPOL_MF_MOVE_ = 2};
+			unsigned long mask[TINA_MAX_NUMA_NODES/BITS + 1] = {0};
+			mask[node/BITS] = 1ul << (node%BITS);
+			// Ignore errors. The memory just ends up wherever it's first touched.
+			syscall(SYS_mbind, ptr, size, MPOL_PREFERRED_, mask, 8*sizeof(mask), MPOL_MF_MOVE_);
+		}
+		
+		static unsigned _tina_current_node(void){
+			unsigned cpu = 0, node = 0;
+			syscall(SYS_getcpu, &cpu, &node, NULL);
+			return node;
+		}
+	#else
+		#define _TINA_NUMA_BIND(_PTR_, _SIZE_, _NODE_) ((void)(_PTR_))
+		#define _TINA_CURRENT_NODE() 0u
+	#endif
+#endif
+
+#if defined(TINA_JOBS_STATS) && !defined(_TINA_MUTEX_TRYLOCK)
+// Must evaluate to true if the lock was acquired.
+#define _TINA_MUTEX_TRYLOCK(_LOCK_) (mtx_trylock(&_LOCK_) == thrd_success)
+#endif
+
+#ifndef _TINA_THREAD_LOCAL
+	#if __cplusplus
+		#define _TINA_THREAD_LOCAL thread_local
+	#elif _MSC_VER
+		#define _TINA_THREAD_LOCAL __declspec(thread)
+	#else
+		#define _TINA_THREAD_LOCAL _Thread_local
+	#endif
+#endif
+
+#ifndef _TINA_NOINLINE
+	#if _MSC_VER
+		#define _TINA_NOINLINE __declspec(noinline)
+	#elif __GNUC__
+		#define _TINA_NOINLINE __attribute__((noinline))
+	#else
+		#define _TINA_NOINLINE
+	#endif
+#endif
+
+#ifndef _TINA_NAME_STATS_CAPACITY
+// Number of unique job names to keep stats for. Must be a power of two. Names past this are counted as "<other>".
+#define _TINA_NAME_STATS_CAPACITY 64
+#endif
+
+#ifndef _TINA_OFFCPU_DEPTH
+// Maximum number of frames to capture when a job is suspended.
+#define _TINA_OFFCPU_DEPTH 16
+#endif
+
+#ifndef _TINA_OFFCPU_SITES
+// Number of unique suspension stacks to aggregate. Must be a power of two.
+#define _TINA_OFFCPU_SITES 256
+#endif
+
+#ifndef _TINA_SYMBOLIZE
+// Override this to write a symbol name for a return address into a buffer. Defaults to hex addresses.
+#define _TINA_SYMBOLIZE(_ADDR_, _BUFFER_, _SIZE_) snprintf(_BUFFER_, _SIZE_, "%p", _ADDR_)
+#endif
+
+#ifndef _TINA_RUN_NEXT_LIMIT
+// Maximum number of jobs a worker runs from it's "run next" slot in a row before going back to it's queue.
+// Keeps a pair of jobs that wait on each other from starving the rest of the queue.
+#define _TINA_RUN_NEXT_LIMIT 16
+#endif
+
+#ifndef _TINA_TRACE_CAPACITY
+// Number of trace events to keep for each worker. Must be a power of two.
+#define _TINA_TRACE_CAPACITY 4096
+#endif
+
+#ifndef _TINA_TRACE_NAME_SIZE
+// Size of the copy of a job's name kept in each trace event, including the terminator. Longer names are truncated.
+#define _TINA_TRACE_NAME_SIZE 32
+#endif
+
 #ifndef _TINA_PROFILE_ENTER
 #define _TINA_PROFILE_ENTER(_JOB_)
 #define _TINA_PROFILE_LEAVE(_JOB_, _STATUS_)
 #endif
 
+#ifndef _TINA_PROBE
+	#ifdef TINA_JOBS_USDT
+		// Static tracepoints for bpftrace, perf, SystemTap, etc. Each is a single nop until a tracer attaches.
+		// Probes are in the "tina" provider. See extras/tina-latency.bt for an example.
+		#include <sys/sdt.h>
+		#define _TINA_PROBE(...) STAP_PROBEV(tina, __VA_ARGS__)
+	#else
+		// Override this to hook the probe points with your own tracing. First argument is the probe name.
+		#define _TINA_PROBE(...)
+	#endif
+#endif
+
+#ifndef _TINA_TIMESTAMP
+	#ifndef TINA_NO_CRT
+		// Override this to use your own monotonic clock. Must return nanoseconds as a uint64_t.
+		#define _TINA_TIMESTAMP() _tina_timestamp()
+		#if defined(__unix__) || defined(__APPLE__)
+			#include <time.h>
+			static inline uint64_t _tina_timestamp(void){
+				struct timespec ts;
+				clock_gettime(CLOCK_MONOTONIC, &ts);
+				return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+			}
+		#elif _WIN32
+			#include <windows.h>
+			static inline uint64_t _tina_timestamp(void){
+				// The frequency is fixed at boot, so racing to initialize it is harmless.
+				static LARGE_INTEGER freq;
+				if(freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+				LARGE_INTEGER counter;
+				QueryPerformanceCounter(&counter);
+				// Split the conversion so it doesn't overflow.
+				uint64_t ticks = (uint64_t)counter.QuadPart, hz = (uint64_t)freq.QuadPart;
+				return ticks/hz*1000000000u + ticks%hz*1000000000u/hz;
+			}
+		#else
+			#include <time.h>
+			#ifndef TIME_MONOTONIC
+				#error "Tina Jobs Error: No monotonic clock found. Define _TINA_TIMESTAMP() to provide one."
+			#endif
+			static inline uint64_t _tina_timestamp(void){
+				struct timespec ts;
+				timespec_get(&ts, TIME_MONOTONIC);
+				return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+			}
+		#endif
+	#else
+		#if defined(TINA_JOBS_LATENCY) || defined(TINA_JOBS_TRACE) || defined(TINA_JOBS_NAME_STATS) || defined(TINA_JOBS_OFFCPU)
+			#error "Tina Jobs Error: Define _TINA_TIMESTAMP() to use the instrumentation with TINA_NO_CRT."
+		#endif
+		// There is no clock without the CRT. TINA_RUN_BUDGET asserts if it's given a time limit.
+		#define _TINA_TIMESTAMP() ((uint64_t)0)
+		#define _TINA_NO_TIMESTAMP
+	#endif
+#endif
+
 struct tina_job {
 	tina_job_description desc;
 	void* user_data;
 	tina* fiber;
 	tina_group* group;
 	tina_job* wait_next;
+	// Group count to wait for, or the number of permits wanted from a tina_job_semaphore.
 	unsigned wait_threshold;
+	// NUMA nodes the job and it's fiber were taken from.
+	unsigned node, fiber_node;
+	// Body and remaining range of a tina_parallel_for() job.
+	tina_for_func* for_func;
+	size_t for_begin, for_end, for_grain;
+	// Graph and node index of a tina_graph_launch() job.
+	tina_graph* graph;
+	unsigned graph_node;
+#ifdef TINA_JOBS_LATENCY
+	// Timestamps of when the job was last pushed to a queue, and when it was last suspended.
+	uint64_t queue_time, suspend_time;
+	// Was the job released from a wait list since it last ran?
+	bool woken;
+#endif
+#ifdef TINA_JOBS_NAME_STATS
+	// Index of the job's name in the scheduler's name stats, and when the job was enqueued.
+	unsigned name_idx;
+	uint64_t enqueue_time;
+#endif
+#ifdef TINA_JOBS_OFFCPU
+	// Return addresses captured when the job was last suspended, and when it happened.
+	void* offcpu_stack[_TINA_OFFCPU_DEPTH];
+	unsigned offcpu_depth;
+	uint64_t offcpu_time;
+	// Was the job suspended since it last ran? The capture can have zero frames, so the depth can't be used for this.
+	bool offcpu_captured;
+#endif
 };
 
 tina_scheduler* tina_job_get_scheduler(tina_job* job){return (tina_scheduler*)job->fiber->user_data;}
@@ -159,32 +843,144 @@ typedef struct {
 } _tina_stack;
 
 // Simple power of two circular queues.
-typedef struct _tina_queue _tina_queue;
-struct _tina_queue{
+typedef struct {
 	void** arr;
 	size_t head, tail, mask;
+} _tina_ring;
+
+typedef struct _tina_queue _tina_queue;
+typedef struct _tina_worker _tina_worker;
+struct _tina_queue{
+	// A ring for each NUMA node.
+	_tina_ring shards[TINA_MAX_NUMA_NODES];
 	
 	// Higher priority queue in the chain. Used for signaling worker threads.
 	_tina_queue* parent;
 	// Lower priority queue in the chain. Used as a fallback when this queue is empty.
 	_tina_queue* fallback;
-	// Semaphore to wait for more work in this queue.
-	_TINA_COND_T semaphore_signal;
-	unsigned semaphore_count;
+	// Workers sleeping while they wait for more work in this queue, linked through 'parked_next', and how many there are.
+	_tina_worker* parked_head;
+	unsigned parked_count;
 	// Incremented each time the queue is interrupted.
 	unsigned interrupt_stamp;
+#ifdef TINA_JOBS_LATENCY
+	tina_queue_latency latency;
+#endif
+};
+
+typedef struct {
+	// Copy of the job's name, since it doesn't have to outlive the job. Empty if it didn't have one.
+	char name[_TINA_TRACE_NAME_SIZE];
+	// Queue the job ran on, and the queue it's scheduled on next.
+	unsigned queue_idx, next_queue_idx;
+	// Status the job left with. (_tina_job_status)
+	unsigned status;
+	// Timestamps of when the job started running and when it stopped.
+	uint64_t begin, end;
+} _tina_trace_event;
+
+// Each thread that runs jobs is assigned a worker when it calls tina_scheduler_run(), and keeps it until the outermost call returns.
+struct _tina_worker {
+	tina_scheduler* sched;
+	// Address of a thread local that identifies the thread the worker belongs to.
+	const void* thread;
+	unsigned idx;
+	// NUMA node to take jobs and fibers from first.
+	unsigned node;
+	// Private queue of jobs that only run on this worker, linked through 'wait_next'.
+	tina_job *private_head, *private_tail;
+	unsigned private_count;
+	// Queue the worker is sleeping on, or NULL. Workers sleep on their own signal in the scheduler so they can be woken individually.
+	_tina_queue* parked;
+	_tina_worker* parked_next;
+	// Queue the worker is running, or NULL if it's thread has released it.
+	_tina_queue* running;
+	// The last job released by a job that completed on this worker, and how many times in a row it's run one.
+	tina_job* run_next;
+	unsigned run_next_streak;
+	// Number of jobs running nested in tina_job_wait_help() calls.
+	unsigned help_depth;
+#ifdef TINA_JOBS_TRACE
+	// Ring buffer of trace events. Only written by the worker's thread while it holds the scheduler lock.
+	_tina_trace_event* trace;
+	size_t trace_count;
+#endif
+#ifdef TINA_JOBS_STATS
+	tina_worker_stats stats;
+#endif
+};
+
+// A thread blocked in tina_group_wait_blocking(). Lives on the thread's stack.
+typedef struct _tina_blocked _tina_blocked;
+struct _tina_blocked {
+	tina_group* group;
+	unsigned threshold;
+	// Queue the thread is running while it waits, or NULL.
+	_tina_queue* queue;
+	_tina_blocked* next;
 };
 
+typedef struct {
+	// Is the site in use? Sites can have zero frames if the stack couldn't be walked.
+	bool used;
+	const char* name;
+	void* stack[_TINA_OFFCPU_DEPTH];
+	unsigned depth;
+	// Number of suspensions and total time suspended.
+	uint64_t count, time;
+} _tina_offcpu_site;
+
 struct tina_scheduler {
 	_TINA_MUTEX_T _lock;
 	
 	_tina_queue* _queues;
 	size_t _queue_count;
 	
-	// Keep the jobs and fiber pools in a stack so recently used items are fresh in the cache.
-	_tina_stack _fibers, _job_pool;
+	_tina_worker* _workers;
+	unsigned _worker_count;
+	// Number of threads in worker pools, so new pools can leave workers for other threads.
+	unsigned _pool_threads;
+#ifdef TINA_JOBS_STATS
+	// Counters for threads that aren't workers.
+	tina_worker_stats _external_stats;
+#endif
+	
+	// Keep the jobs and fiber pools in a stack so recently used items are fresh in the cache. One for each NUMA node.
+	_tina_stack _fibers[TINA_MAX_NUMA_NODES], _job_pool[TINA_MAX_NUMA_NODES];
+	unsigned _node_count;
+	// Pool capacities, how many are free on all nodes, and the lowest counts they have reached.
+	unsigned _fiber_count, _job_count;
+	unsigned _fibers_free, _jobs_free;
+	unsigned _fibers_low, _job_pool_low;
+	// Number of jobs suspended on group wait lists.
+	unsigned _waiting_count;
+	// Threads blocked on groups, and the signal for the ones that aren't running a queue.
+	_tina_blocked* _blocked;
+	_TINA_COND_T _blocked_signal;
+	// Signals for each worker to sleep on while it's parked.
+	_TINA_COND_T _worker_signals[TINA_MAX_WORKERS];
+#ifdef TINA_JOBS_NAME_STATS
+	// Open addressed hash table of names, with an extra entry at the end for overflow.
+	tina_name_stats _name_stats[_TINA_NAME_STATS_CAPACITY + 1];
+#endif
+#ifdef TINA_JOBS_OFFCPU
+	// Open addressed hash table of suspension sites, and the count of suspensions that didn't fit.
+	_tina_offcpu_site _offcpu_sites[_TINA_OFFCPU_SITES];
+	uint64_t _offcpu_dropped;
+#endif
 };
 
+static const tina_worker_stats _TINA_WORKER_STATS_ZERO = {0, 0, 0, 0, 0, 0};
+
+static _TINA_THREAD_LOCAL char _TINA_THREAD_TOKEN;
+// Cache the last worker used by the thread, and it's scheduler, to avoid searching for it.
+static _TINA_THREAD_LOCAL _tina_worker* _TINA_THREAD_WORKER;
+static _TINA_THREAD_LOCAL tina_scheduler* _TINA_THREAD_SCHED;
+// The job this thread is currently running.
+static _TINA_THREAD_LOCAL tina_job* _TINA_THREAD_JOB;
+// NUMA node set by tina_worker_set_node() plus one, or 0 if it wasn't set.
+static _TINA_THREAD_LOCAL unsigned _TINA_THREAD_NODE;
+
 typedef enum {
 	_TINA_STATUS_COMPLETED,
 	_TINA_STATUS_WAITING,
@@ -203,34 +999,128 @@ static uintptr_t _tina_jobs_fiber(tina* fiber, uintptr_t value){
 
 static inline size_t _tina_jobs_align(size_t n){return -(-n & -_TINA_MAX_ALIGN);}
 
-size_t tina_scheduler_size(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size){
+static inline unsigned _tina_log2(uint64_t n){
+#if __GNUC__
+	return 63 - __builtin_clzll(n);
+#else
+	unsigned log = 0;
+	while(n >>= 1) log++;
+	return log;
+#endif
+}
+
+static inline unsigned _tina_histogram_bucket(uint64_t value){
+	const unsigned sub_bits = TINA_HISTOGRAM_SUB_BITS;
+	// Small values get a bucket each, and values that are too large are clamped to the last bucket.
+	if(value < (1u << sub_bits)) return (unsigned)value;
+	if(value >> TINA_HISTOGRAM_MAX_BITS) return TINA_HISTOGRAM_BUCKETS - 1;
+	
+	// Otherwise each power of two is split linearly into sub-buckets using the bits below the leading one.
+	unsigned shift = _tina_log2(value) - sub_bits;
+	return ((shift + 1) << sub_bits) + (unsigned)(value >> shift) - (1u << sub_bits);
+}
+
+// Largest value that maps to a bucket.
+static inline uint64_t _tina_histogram_bucket_value(unsigned bucket){
+	const unsigned sub_bits = TINA_HISTOGRAM_SUB_BITS;
+	if(bucket < (1u << sub_bits)) return bucket;
+	
+	unsigned shift = (bucket >> sub_bits) - 1;
+	uint64_t mantissa = (bucket & ((1u << sub_bits) - 1)) + (1u << sub_bits);
+	return ((mantissa + 1) << shift) - 1;
+}
+
+static inline void _tina_histogram_reset(tina_histogram* hist){
+	hist->count = hist->total = hist->min = hist->max = 0;
+	for(unsigned i = 0; i < TINA_HISTOGRAM_BUCKETS; i++) hist->buckets[i] = 0;
+}
+
+static inline void _tina_latency_reset(tina_queue_latency* latency){
+	_tina_histogram_reset(&latency->queued);
+	_tina_histogram_reset(&latency->suspended);
+	_tina_histogram_reset(&latency->wake);
+}
+
+static inline void _tina_histogram_record(tina_histogram* hist, uint64_t value){
+	if(hist->count == 0 || value < hist->min) hist->min = value;
+	if(value > hist->max) hist->max = value;
+	hist->count++;
+	hist->total += value;
+	hist->buckets[_tina_histogram_bucket(value)]++;
+}
+
+uint64_t tina_histogram_percentile(const tina_histogram* hist, double percentile){
+	if(hist->count == 0) return 0;
+	
+	// Rank of the sample we are looking for, rounded up.
+	double rank = percentile*hist->count/100;
+	uint64_t target = (uint64_t)rank;
+	if(target < rank) target++;
+	if(target < 1) target = 1;
+	
+	uint64_t sum = 0;
+	for(unsigned i = 0; i < TINA_HISTOGRAM_BUCKETS; i++){
+		sum += hist->buckets[i];
+		if(sum >= target){
+			uint64_t value = _tina_histogram_bucket_value(i);
+			return value < hist->max ? value : hist->max;
+		}
+	}
+	
+	return hist->max;
+}
+
+size_t tina_scheduler_size_numa(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count){
+	// Padding to page align each node's jobs and fibers.
+	size_t node_padding = node_count > 1 ? node_count*_TINA_PAGE_SIZE : 0;
+	
 	size_t size = 0;
 	// Size of scheduler.
 	size += _tina_jobs_align(sizeof(tina_scheduler));
 	// Size of queues.
 	size += _tina_jobs_align(queue_count*sizeof(_tina_queue));
+	// Size of workers.
+	size += _tina_jobs_align(TINA_MAX_WORKERS*sizeof(_tina_worker));
+#ifdef TINA_JOBS_TRACE
+	// Size of trace buffers.
+	size += TINA_MAX_WORKERS*_tina_jobs_align(_TINA_TRACE_CAPACITY*sizeof(_tina_trace_event));
+#endif
 	// Size of fiber pool array.
 	size += _tina_jobs_align(fiber_count*sizeof(void*));
 	// Size of job pool array.
 	size += _tina_jobs_align(job_count*sizeof(void*));
 	// Size of queue arrays.
-	size += queue_count*_tina_jobs_align(job_count*sizeof(void*));
+	size += queue_count*node_count*_tina_jobs_align(job_count*sizeof(void*));
 	// Size of jobs.
-	size += job_count*_tina_jobs_align(sizeof(tina_job));
+	size += job_count*_tina_jobs_align(sizeof(tina_job)) + node_padding;
 	// Size of fibers.
-	size += fiber_count*stack_size;
+	size += fiber_count*stack_size + node_padding;
 	return size;
 }
 
+size_t tina_scheduler_size(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size){
+	return tina_scheduler_size_numa(job_count, queue_count, fiber_count, stack_size, 1);
+}
+
 typedef tina* _tina_fiber_factory(tina_scheduler* sched, unsigned fiber_idx, void* buffer, size_t stack_size, void* user_ptr);
 
 static tina* _tina_jobs_default_fiber_factory(tina_scheduler* sched, unsigned fiber_idx, void* buffer, size_t stack_size, void* factory_data){
 	return tina_init(buffer, stack_size, (tina_func*)factory_data, sched);
 }
 
-static tina_scheduler* _tina_scheduler_init2(void* buffer, unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, _tina_fiber_factory* fiber_factory, void* factory_data){
+// Page align and bind the start of a node's memory when there is more than one node.
+static uint8_t* _tina_node_memory(uint8_t* cursor, size_t size, unsigned node, unsigned node_count){
+	if(node_count == 1) return cursor;
+	
+	cursor = (uint8_t*)(-(-(uintptr_t)cursor & -(uintptr_t)_TINA_PAGE_SIZE));
+	_TINA_NUMA_BIND(cursor, size, node);
+	return cursor;
+}
+
+static tina_scheduler* _tina_scheduler_init2(void* buffer, unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count, _tina_fiber_factory* fiber_factory, void* factory_data){
 	_TINA_ASSERT((job_count & (job_count - 1)) == 0, "Tina Jobs Error: Job count must be a power of two.");
 	_TINA_ASSERT((stack_size & (stack_size - 1)) == 0, "Tina Jobs Error: Stack size must be a power of two.");
+	_TINA_ASSERT(node_count > 0 && node_count <= TINA_MAX_NUMA_NODES, "Tina Jobs Error: Invalid node count. (Increase TINA_MAX_NUMA_NODES)");
 	uint8_t* cursor = (uint8_t*)buffer;
 	
 	// Sub allocate all of the memory for the various arrays.
@@ -238,56 +1128,116 @@ static tina_scheduler* _tina_scheduler_init2(void* buffer, unsigned job_count, u
 	cursor += _tina_jobs_align(sizeof(tina_scheduler));
 	sched->_queues = (_tina_queue*)cursor;
 	cursor += _tina_jobs_align(queue_count*sizeof(_tina_queue));
-	sched->_fibers = (_tina_stack){.arr = (void**)cursor, .count = 0};
+	sched->_workers = (_tina_worker*)cursor;
+	cursor += _tina_jobs_align(TINA_MAX_WORKERS*sizeof(_tina_worker));
+	void** fiber_arr = (void**)cursor;
 	cursor += _tina_jobs_align(fiber_count*sizeof(void*));
-	sched->_job_pool = (_tina_stack){.arr = (void**)cursor, .count = 0};
+	void** job_arr = (void**)cursor;
 	cursor += _tina_jobs_align(job_count*sizeof(void*));
 	
 	// Initialize the queues arrays.
 	sched->_queue_count = queue_count;
 	for(unsigned i = 0; i < queue_count; i++){
 		_tina_queue* queue = &sched->_queues[i];
-		queue->arr = (void**)cursor;
-		queue->head = queue->tail = 0;
-		queue->mask = job_count - 1;
+		for(unsigned node = 0; node < node_count; node++){
+			queue->shards[node] = (_tina_ring){.arr = (void**)cursor, .head = 0, .tail = 0, .mask = job_count - 1};
+			cursor += _tina_jobs_align(job_count*sizeof(void*));
+		}
 		queue->parent = queue->fallback = NULL;
-		_TINA_COND_INIT(queue->semaphore_signal);
-		queue->semaphore_count = 0;
-		
-		cursor += _tina_jobs_align(job_count*sizeof(void*));
+		queue->parked_head = NULL;
+		queue->parked_count = 0;
+#ifdef TINA_JOBS_LATENCY
+		_tina_latency_reset(&queue->latency);
+#endif
+	}
+	
+	// Workers are assigned as threads start running jobs.
+	sched->_worker_count = sched->_pool_threads = 0;
+	for(unsigned i = 0; i < TINA_MAX_WORKERS; i++){
+		_tina_worker* worker = &sched->_workers[i];
+		(*worker) = (_tina_worker){
+			.sched = sched, .thread = NULL, .idx = i, .node = 0,
+			.private_head = NULL, .private_tail = NULL, .private_count = 0, .parked = NULL, .parked_next = NULL,
+			.running = NULL, .run_next = NULL, .run_next_streak = 0, .help_depth = 0,
+#ifdef TINA_JOBS_TRACE
+			.trace = (_tina_trace_event*)cursor, .trace_count = 0,
+#endif
+#ifdef TINA_JOBS_STATS
+			.stats = _TINA_WORKER_STATS_ZERO,
+#endif
+		};
+#ifdef TINA_JOBS_TRACE
+		cursor += _tina_jobs_align(_TINA_TRACE_CAPACITY*sizeof(_tina_trace_event));
+#endif
+		_TINA_COND_INIT(sched->_worker_signals[i]);
 	}
 	
-	// Fill the job pool.
-	sched->_job_pool.count = job_count;
-	for(unsigned i = 0; i < job_count; i++){
-		sched->_job_pool.arr[i] = cursor;
-		cursor += _tina_jobs_align(sizeof(tina_job));
+#ifdef TINA_JOBS_STATS
+	sched->_external_stats = _TINA_WORKER_STATS_ZERO;
+#endif
+	sched->_node_count = node_count;
+	sched->_job_count = sched->_jobs_free = sched->_job_pool_low = job_count;
+	sched->_fiber_count = sched->_fibers_free = sched->_fibers_low = fiber_count;
+	sched->_waiting_count = 0;
+	sched->_blocked = NULL;
+	_TINA_COND_INIT(sched->_blocked_signal);
+#ifdef TINA_JOBS_NAME_STATS
+	for(unsigned i = 0; i <= _TINA_NAME_STATS_CAPACITY; i++) sched->_name_stats[i] = (tina_name_stats){NULL, 0, 0, 0, 0};
+	sched->_name_stats[_TINA_NAME_STATS_CAPACITY].name = "<other>";
+#endif
+#ifdef TINA_JOBS_OFFCPU
+	for(unsigned i = 0; i < _TINA_OFFCPU_SITES; i++) sched->_offcpu_sites[i].used = false;
+	sched->_offcpu_dropped = 0;
+#endif
+	
+	// Split the job pool evenly between the nodes. Each node's pool only holds it's own jobs so they can share one array.
+	for(unsigned node = 0; node < node_count; node++){
+		unsigned begin = job_count*node/node_count, end = job_count*(node + 1)/node_count;
+		cursor = _tina_node_memory(cursor, (end - begin)*_tina_jobs_align(sizeof(tina_job)), node, node_count);
+		sched->_job_pool[node] = (_tina_stack){.arr = job_arr + begin, .count = end - begin};
+		for(unsigned i = begin; i < end; i++){
+			job_arr[i] = cursor;
+			cursor += _tina_jobs_align(sizeof(tina_job));
+		}
 	}
 	
-	// Initialize the fibers and fill the pool.
-	sched->_fibers.count = fiber_count;
-	for(unsigned i = 0; i < fiber_count; i++){
-		sched->_fibers.arr[i] = fiber_factory(sched, i, cursor, stack_size, factory_data);
-		cursor += stack_size;
+	// Initialize the fibers and fill the pools. Binding the memory first means the stacks are first touched on the right node.
+	for(unsigned node = 0; node < node_count; node++){
+		unsigned begin = fiber_count*node/node_count, end = fiber_count*(node + 1)/node_count;
+		cursor = _tina_node_memory(cursor, (end - begin)*stack_size, node, node_count);
+		sched->_fibers[node] = (_tina_stack){.arr = fiber_arr + begin, .count = end - begin};
+		for(unsigned i = begin; i < end; i++){
+			fiber_arr[i] = fiber_factory(sched, i, cursor, stack_size, factory_data);
+			cursor += stack_size;
+		}
 	}
 	
 	_TINA_MUTEX_INIT(sched->_lock);
 	return sched;
 }
 
+tina_scheduler* tina_scheduler_init_numa(void* buffer, unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count){
+	return _tina_scheduler_init2(buffer, job_count, queue_count, fiber_count, stack_size, node_count, _tina_jobs_default_fiber_factory, (void*)_tina_jobs_fiber);
+}
+
 tina_scheduler* tina_scheduler_init(void* buffer, unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size){
-	return _tina_scheduler_init2(buffer, job_count, queue_count, fiber_count, stack_size, _tina_jobs_default_fiber_factory, (void*)_tina_jobs_fiber);
+	return tina_scheduler_init_numa(buffer, job_count, queue_count, fiber_count, stack_size, 1);
 }
 
 void tina_scheduler_destroy(tina_scheduler* sched){
 	_TINA_MUTEX_DESTROY(sched->_lock);
-	for(unsigned i = 0; i < sched->_queue_count; i++) _TINA_COND_DESTROY(sched->_queues[i].semaphore_signal);
+	_TINA_COND_DESTROY(sched->_blocked_signal);
+	for(unsigned i = 0; i < TINA_MAX_WORKERS; i++) _TINA_COND_DESTROY(sched->_worker_signals[i]);
 }
 
 #ifndef TINA_NO_CRT
+tina_scheduler* tina_scheduler_new_numa(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size, unsigned node_count){
+	void* buffer = malloc(tina_scheduler_size_numa(job_count, queue_count, fiber_count, stack_size, node_count));
+	return tina_scheduler_init_numa(buffer, job_count, queue_count, fiber_count, stack_size, node_count);
+}
+
 tina_scheduler* tina_scheduler_new(unsigned job_count, unsigned queue_count, unsigned fiber_count, size_t stack_size){
-	void* buffer = malloc(tina_scheduler_size(job_count, queue_count, fiber_count, stack_size));
-	return tina_scheduler_init(buffer, job_count, queue_count, fiber_count, stack_size);
+	return tina_scheduler_new_numa(job_count, queue_count, fiber_count, stack_size, 1);
 }
 
 void tina_scheduler_free(tina_scheduler* sched){
@@ -311,160 +1261,1435 @@ void tina_scheduler_queue_priority(tina_scheduler* sched, unsigned queue_idx, un
 	fallback->parent = parent;
 }
 
-static tina_job* _tina_queue_next_job(_tina_queue* queue){
-	if(queue->head != queue->tail){
-		return (tina_job*)queue->arr[queue->tail++ & queue->mask];
-	} else if(queue->fallback){
-		return _tina_queue_next_job(queue->fallback);
-	} else {
-		return NULL;
+static tina_job* _tina_queue_next_job(_tina_queue* queue, unsigned node, unsigned node_count){
+	// Check the whole priority chain on the worker's own node before stealing from the other nodes.
+	for(unsigned i = 0; i < node_count; i++){
+		for(_tina_queue* q = queue; q; q = q->fallback){
+			_tina_ring* ring = &q->shards[node];
+			if(ring->head != ring->tail) return (tina_job*)ring->arr[ring->tail++ & ring->mask];
+		}
+		node = node + 1 < node_count ? node + 1 : 0;
 	}
+	return NULL;
+}
+
+// Remove a sleeping worker from the queue it's parked on and wake it up.
+static void _tina_worker_unpark(_tina_worker* worker){
+	_tina_queue* queue = worker->parked;
+	_tina_worker** link = &queue->parked_head;
+	while(*link != worker) link = &(*link)->parked_next;
+	*link = worker->parked_next;
+	queue->parked_count--;
+	
+	worker->parked = NULL;
+	worker->parked_next = NULL;
+	_TINA_COND_SIGNAL(worker->sched->_worker_signals[worker->idx]);
 }
 
 static void _tina_queue_signal(_tina_queue* queue){
-	if(queue->semaphore_count){
-		_TINA_COND_SIGNAL(queue->semaphore_signal);
-		queue->semaphore_count--;
+	if(queue->parked_head){
+		_tina_worker_unpark(queue->parked_head);
 	} else if(queue->parent){
 		_tina_queue_signal(queue->parent);
 	}
 }
 
-static tina_job* _tina_group_process_wait_list(tina_scheduler* sched, tina_group* group, tina_job* job){
-	if(job){
-		tina_job* next = _tina_group_process_wait_list(sched, group, job->wait_next);
-		if(group->_count <= job->wait_threshold){
-			// Push the waiting job to the back of it's queue.
-			_tina_queue* queue = &sched->_queues[job->desc.queue_idx];
-			queue->arr[queue->head++ & queue->mask] = job;
-			_tina_queue_signal(queue);
-			
-			// Unlink from wait list.
-			job->wait_next = NULL;
-			return next;
-		} else {
-			job->wait_next = next;
-		}
+// Wake every thread sleeping on a queue. Threads that still have nothing to do go back to sleep.
+static void _tina_queue_wake_all(_tina_queue* queue){
+	while(queue->parked_head) _tina_worker_unpark(queue->parked_head);
+}
+
+static inline void _tina_queue_push(_tina_queue* queue, unsigned node, tina_job* job){
+	_tina_ring* ring = &queue->shards[node];
+	ring->arr[ring->head++ & ring->mask] = job;
+	_tina_queue_signal(queue);
+}
+
+// Pop an item from a node's pool, or the next node with a free item. Returns the node it came from in 'node'.
+// The caller must check that there is a free item.
+static inline void* _tina_pool_pop(_tina_stack* pools, unsigned node_count, unsigned* node){
+	unsigned n = *node;
+	while(pools[n].count == 0) n = n + 1 < node_count ? n + 1 : 0;
+	*node = n;
+	return pools[n].arr[--pools[n].count];
+}
+
+// Check if any threads are sleeping while waiting for work from a queue. The same ones _tina_queue_signal() would wake.
+// Can be called without the lock to get a hint that may be stale.
+static bool _tina_queue_has_idle(_tina_queue* queue){
+	for(; queue; queue = queue->parent){
+		if(_TINA_ATOMIC_LOAD(&queue->parked_count)) return true;
 	}
+	return false;
+}
+
+static void _tina_worker_push(tina_scheduler* sched, unsigned worker_idx, tina_job* job){
+	_TINA_ASSERT(worker_idx < TINA_MAX_WORKERS, "Tina Jobs Error: Invalid worker queue index.");
+	_tina_worker* worker = &sched->_workers[worker_idx];
+	job->wait_next = NULL;
+	if(worker->private_tail) worker->private_tail->wait_next = job; else worker->private_head = job;
+	worker->private_tail = job;
+	worker->private_count++;
 	
+	// Wake the worker if it's sleeping. Only the owner can run the job, so leave the rest of the queue's workers asleep.
+	if(worker->parked) _tina_worker_unpark(worker);
+}
+
+static inline tina_job* _tina_worker_next_job(_tina_worker* worker){
+	tina_job* job = worker->private_head;
+	if(job){
+		worker->private_head = job->wait_next;
+		if(worker->private_head == NULL) worker->private_tail = NULL;
+		worker->private_count--;
+		job->wait_next = NULL;
+	}
 	return job;
 }
 
-static inline unsigned _tina_group_increment(tina_group* group, unsigned count, unsigned max_count){
-	if(max_count > 0){
-		// Handle already full.
-		if(group->_count >= max_count) return 0;
-		// Adjust count.
-		unsigned remaining = max_count - group->_count;
-		if(count > remaining) count = remaining;
+// Push a job to the back of the queue in it's description.
+static inline void _tina_scheduler_push(tina_scheduler* sched, tina_job* job, unsigned node){
+	unsigned queue_idx = job->desc.queue_idx;
+	if(queue_idx & TINA_WORKER_QUEUE_FLAG){
+		_tina_worker_push(sched, queue_idx & ~TINA_WORKER_QUEUE_FLAG, job);
+	} else {
+		_tina_queue_push(_tina_get_queue(sched, queue_idx), node, job);
 	}
-	
-	group->_count += count;
-	return count;
 }
 
-static inline void _tina_group_decrement(tina_scheduler* sched, tina_group* group, unsigned count){
-	group->_count -= count;
-	group->_job_list = _tina_group_process_wait_list(sched, group, group->_job_list);
+#ifdef TINA_JOBS_LATENCY
+// Get the latency histograms for a job's queue, or NULL for worker queues.
+static inline tina_queue_latency* _tina_job_latency(tina_scheduler* sched, tina_job* job){
+	unsigned queue_idx = job->desc.queue_idx;
+	return queue_idx & TINA_WORKER_QUEUE_FLAG ? NULL : &sched->_queues[queue_idx].latency;
 }
+#endif
 
-static inline void _tina_scheduler_execute_job(tina_scheduler* sched, tina_job* job){
-	_TINA_ASSERT(sched->_fibers.count > 0, "Tina Jobs Error: Ran out of fibers.");
-	// Assign a fiber and the thread data. (Jobs that are resuming already have a fiber)
-	if(job->fiber == NULL) job->fiber = (tina*)sched->_fibers.arr[--sched->_fibers.count];
-	
-	// Unlock the scheduler while executing the job. Fibers re-lock it before yielding back.
-	_TINA_MUTEX_UNLOCK(sched->_lock);
-	
+// Check if a job's queue is one the worker is currently running.
+static bool _tina_worker_runs_queue(tina_scheduler* sched, _tina_worker* worker, unsigned queue_idx){
+	if(queue_idx & TINA_WORKER_QUEUE_FLAG) return (queue_idx & ~TINA_WORKER_QUEUE_FLAG) == worker->idx;
+	for(_tina_queue* queue = worker->running; queue; queue = queue->fallback){
+		if(queue == &sched->_queues[queue_idx]) return true;
+	}
+	return false;
+}
+
+// Node to push a released job to. Continuations don't have a fiber yet, so use the job's node.
+static inline unsigned _tina_job_wake_node(const tina_job* job){
+	return job->fiber ? job->fiber_node : job->node;
+}
+
+// Push a job that's done waiting to the back of it's queue, or to the worker's "run next" slot if it's not NULL. Scheduler must be locked.
+static void _tina_job_wake(tina_scheduler* sched, tina_job* job, _tina_worker* worker){
+	_TINA_PROBE(wake, job, job->desc.name, job->desc.queue_idx);
+#ifdef TINA_JOBS_LATENCY
+	uint64_t now = _TINA_TIMESTAMP();
+	// Continuations haven't started yet, so they were never suspended.
+	if(job->fiber){
+		tina_queue_latency* latency = _tina_job_latency(sched, job);
+		if(latency) _tina_histogram_record(&latency->suspended, now - job->suspend_time);
+		job->woken = true;
+	}
+	job->queue_time = now;
+#endif
+	job->wait_next = NULL;
+	if(worker && _tina_worker_runs_queue(sched, worker, job->desc.queue_idx)){
+		// Bump the previous job out of the slot. It's caches are colder anyway.
+		if(worker->run_next) _tina_scheduler_push(sched, worker->run_next, _tina_job_wake_node(worker->run_next));
+		worker->run_next = job;
+	} else {
+		_tina_scheduler_push(sched, job, _tina_job_wake_node(job));
+	}
+	sched->_waiting_count--;
+}
+
+// Release the jobs that are done waiting. If 'worker' is not NULL, the last job released it can run goes in it's "run next" slot.
+static tina_job* _tina_group_process_wait_list(tina_scheduler* sched, tina_group* group, tina_job* job, _tina_worker* worker){
+	// New waiters are pushed to the front, so reverse the list to release the oldest ones first.
+	tina_job* reversed = NULL;
+	while(job){
+		tina_job* next = job->wait_next;
+		job->wait_next = reversed;
+		reversed = job;
+		job = next;
+	}
+	
+	// Reversing it again while unlinking the released jobs puts the rest back in their original order.
+	tina_job* list = NULL;
+	while(reversed){
+		job = reversed;
+		reversed = job->wait_next;
+		if(group->_count <= job->wait_threshold){
+			// Push the waiting job to the back of it's queue.
+			_tina_job_wake(sched, job, worker);
+		} else {
+			job->wait_next = list;
+			list = job;
+		}
+	}
+	
+	return list;
+}
+
+static inline unsigned _tina_group_increment(tina_group* group, unsigned count, unsigned max_count){
+	if(max_count > 0){
+		// Handle already full.
+		if(group->_count >= max_count) return 0;
+		// Adjust count.
+		unsigned remaining = max_count - group->_count;
+		if(count > remaining) count = remaining;
+	}
+	
+	group->_count += count;
+	return count;
+}
+
+static inline bool _tina_blocked_ready(const _tina_blocked* blocked){
+	return blocked->group->_count <= blocked->threshold;
+}
+
+static void _tina_blocked_link(tina_scheduler* sched, _tina_blocked* blocked){
+	blocked->next = sched->_blocked;
+	sched->_blocked = blocked;
+}
+
+static void _tina_blocked_unlink(tina_scheduler* sched, _tina_blocked* blocked){
+	_tina_blocked** link = &sched->_blocked;
+	while(*link != blocked) link = &(*link)->next;
+	*link = blocked->next;
+}
+
+// Wake the threads blocked on a group that are done waiting.
+static void _tina_group_wake_blocked(tina_scheduler* sched, tina_group* group){
+	bool signal = false;
+	for(_tina_blocked* blocked = sched->_blocked; blocked; blocked = blocked->next){
+		if(blocked->group != group || !_tina_blocked_ready(blocked)) continue;
+		// Threads running a queue sleep on the queue instead.
+		if(blocked->queue) _tina_queue_wake_all(blocked->queue); else signal = true;
+	}
+	
+	if(signal) _TINA_COND_BROADCAST(sched->_blocked_signal);
+}
+
+static inline void _tina_group_decrement(tina_scheduler* sched, tina_group* group, unsigned count, _tina_worker* worker){
+	group->_count -= count;
+	group->_job_list = _tina_group_process_wait_list(sched, group, group->_job_list, worker);
+	if(sched->_blocked) _tina_group_wake_blocked(sched, group);
+}
+
+// Get the calling thread's cached worker if it belongs to 'sched'.
+static inline _tina_worker* _tina_cached_worker(tina_scheduler* sched){
+	// Check the scheduler before touching the worker, the cached one may have been freed.
+	// A new scheduler can reuse the address though, so check that the worker is really this thread's too.
+	if(_TINA_THREAD_SCHED != sched) return NULL;
+	return _TINA_THREAD_WORKER->thread == &_TINA_THREAD_TOKEN ? _TINA_THREAD_WORKER : NULL;
+}
+
+static inline _tina_worker* _tina_cache_worker(_tina_worker* worker){
+	_TINA_THREAD_SCHED = worker->sched;
+	return _TINA_THREAD_WORKER = worker;
+}
+
+static unsigned _tina_thread_node_hint(void){
+	return _TINA_THREAD_NODE ? _TINA_THREAD_NODE - 1 : _TINA_CURRENT_NODE();
+}
+
+// Find or assign the worker for the calling thread. Scheduler must be locked.
+// Workers are only held while their thread is in tina_scheduler_run(), so the limit is on threads running the scheduler at once.
+static _tina_worker* _tina_scheduler_worker(tina_scheduler* sched){
+	_tina_worker* worker = _tina_cached_worker(sched);
+	if(worker) return worker;
+	
+	// Give the thread back the worker it had last time if it can, otherwise an unused one.
+	_tina_worker* released = NULL;
+	for(unsigned i = 0; i < sched->_worker_count; i++){
+		worker = &sched->_workers[i];
+		if(worker->thread == &_TINA_THREAD_TOKEN) return _tina_cache_worker(worker);
+		if(released == NULL && worker->running == NULL) released = worker;
+	}
+	
+	// Recycle a worker released by a thread that stopped running the scheduler once they have all been used.
+	worker = sched->_worker_count < TINA_MAX_WORKERS ? &sched->_workers[sched->_worker_count++] : released;
+	_TINA_ASSERT(worker, "Tina Jobs Error: Too many threads running the scheduler at once. (Increase TINA_MAX_WORKERS)");
+	worker->thread = &_TINA_THREAD_TOKEN;
+	worker->node = sched->_node_count > 1 ? _tina_thread_node_hint() % sched->_node_count : 0;
+	return _tina_cache_worker(worker);
+}
+
+// Get the NUMA node the calling thread should queue jobs on. Scheduler must be locked.
+static inline unsigned _tina_thread_node(tina_scheduler* sched){
+	if(sched->_node_count == 1) return 0;
+	_tina_worker* worker = _tina_cached_worker(sched);
+	return worker ? worker->node : _tina_thread_node_hint() % sched->_node_count;
+}
+
+#ifdef TINA_JOBS_OFFCPU
+static _TINA_NOINLINE void _tina_offcpu_capture(tina_job* job){
+	job->offcpu_depth = 0;
+	job->offcpu_time = _TINA_TIMESTAMP();
+	job->offcpu_captured = true;
+#if __GNUC__
+	// Walk the frame pointer chain the same way extras/tina.gdb does, but stay inside the fiber's stack.
+	// Each frame record holds the caller's frame pointer followed by the return address.
+	uintptr_t lo = (uintptr_t)job->fiber->buffer, hi = lo + job->fiber->size;
+	void** frame = (void**)__builtin_frame_address(0);
+	while(job->offcpu_depth < _TINA_OFFCPU_DEPTH && lo <= (uintptr_t)frame && (uintptr_t)frame + 2*sizeof(void*) <= hi){
+		void* addr = frame[1];
+		if(addr == NULL) break;
+		job->offcpu_stack[job->offcpu_depth++] = addr;
+		
+		// Stacks grow down, so the caller's frame must be above this one.
+		void** next = (void**)frame[0];
+		if(next <= frame) break;
+		frame = next;
+	}
+#endif
+}
+
+// Add the time a job was suspended to it's site. Scheduler must be locked.
+static void _tina_offcpu_record(tina_scheduler* sched, tina_job* job){
+	uint64_t hash = (uintptr_t)job->desc.name;
+	for(unsigned i = 0; i < job->offcpu_depth; i++) hash = (hash ^ (uintptr_t)job->offcpu_stack[i])*0x100000001B3ull;
+	
+	const unsigned mask = _TINA_OFFCPU_SITES - 1;
+	for(unsigned i = 0; i < _TINA_OFFCPU_SITES; i++){
+		_tina_offcpu_site* site = &sched->_offcpu_sites[(hash + i) & mask];
+		if(!site->used){
+			site->used = true;
+			site->name = job->desc.name;
+			site->depth = job->offcpu_depth;
+			for(unsigned j = 0; j < job->offcpu_depth; j++) site->stack[j] = job->offcpu_stack[j];
+			site->count = site->time = 0;
+		}
+		
+		bool match = site->name == job->desc.name && site->depth == job->offcpu_depth;
+		for(unsigned j = 0; match && j < job->offcpu_depth; j++) match = site->stack[j] == job->offcpu_stack[j];
+		if(match){
+			site->count++;
+			site->time += _TINA_TIMESTAMP() - job->offcpu_time;
+			return;
+		}
+	}
+	
+	sched->_offcpu_dropped++;
+}
+#endif
+
+static inline void _tina_scheduler_lock(tina_scheduler* sched){
+#ifdef TINA_JOBS_STATS
+	bool contended = !_TINA_MUTEX_TRYLOCK(sched->_lock);
+	if(contended) _TINA_MUTEX_LOCK(sched->_lock);
+	
+	// Count it against the calling thread's worker if it has one.
+	_tina_worker* worker = _tina_cached_worker(sched);
+	tina_worker_stats* stats = worker ? &worker->stats : &sched->_external_stats;
+	stats->lock_acquisitions++;
+	stats->lock_contended += contended;
+#else
+	_TINA_MUTEX_LOCK(sched->_lock);
+#endif
+}
+
+// These must not be inlined into jobs. A job may resume on another thread, and compilers can cache thread local addresses.
+_TINA_NOINLINE tina_job* tina_job_current(void){return _TINA_THREAD_JOB;}
+
+_TINA_NOINLINE unsigned tina_worker_index(tina_scheduler* sched){
+	_tina_worker* worker = _tina_cached_worker(sched);
+	_TINA_ASSERT(worker, "Tina Jobs Error: Calling thread is not running the scheduler.");
+	return worker->idx;
+}
+
+unsigned tina_worker_count(tina_scheduler* sched){
+	_tina_scheduler_lock(sched);
+	unsigned count = sched->_worker_count;
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+	return count;
+}
+
+void tina_worker_set_node(unsigned node){_TINA_THREAD_NODE = node + 1;}
+
+_TINA_NOINLINE unsigned tina_worker_node(void){
+	_TINA_ASSERT(_TINA_THREAD_WORKER, "Tina Jobs Error: Calling thread has not run a scheduler.");
+	return _TINA_THREAD_WORKER->node;
+}
+
+#ifdef TINA_JOBS_TRACE
+static inline void _tina_trace_name(char* dst, const char* name){
+	size_t i = 0;
+	if(name) for(; name[i] && i < _TINA_TRACE_NAME_SIZE - 1; i++) dst[i] = name[i];
+	dst[i] = 0;
+}
+#endif
+
+static inline void _tina_scheduler_execute_job(tina_scheduler* sched, tina_job* job, _tina_worker* worker){
+	// Assign a fiber and the thread data. (Jobs that are resuming already have a fiber)
+	if(job->fiber == NULL){
+		_TINA_ASSERT(sched->_fibers_free > 0, "Tina Jobs Error: Ran out of fibers.");
+		job->fiber_node = worker->node;
+		job->fiber = (tina*)_tina_pool_pop(sched->_fibers, sched->_node_count, &job->fiber_node);
+		if(sched->_fibers_low > --sched->_fibers_free) sched->_fibers_low = sched->_fibers_free;
+		_TINA_PROBE(start, job, job->desc.name, job->desc.queue_idx, worker->idx);
+	} else {
+		_TINA_PROBE(resume, job, job->desc.name, job->desc.queue_idx, worker->idx);
+	}
+	
+#ifdef TINA_JOBS_OFFCPU
+	// Resuming a suspended job?
+	if(job->offcpu_captured){
+		_tina_offcpu_record(sched, job);
+		job->offcpu_captured = false;
+	}
+#endif
+	
+#ifdef TINA_JOBS_LATENCY
+	tina_queue_latency* latency = _tina_job_latency(sched, job);
+	if(latency) _tina_histogram_record(job->woken ? &latency->wake : &latency->queued, _TINA_TIMESTAMP() - job->queue_time);
+	job->woken = false;
+#endif
+	
+	// Unlock the scheduler while executing the job. Fibers re-lock it before yielding back.
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+	
+	// Remember the queue to detect when the job switches queues.
+	unsigned queue_idx = job->desc.queue_idx;
+	(void)queue_idx;
+#ifdef TINA_JOBS_TRACE
+	// Copy the name before running the job. It may not be valid anymore once the job completes.
+	_tina_trace_event event;
+	_tina_trace_name(event.name, job->desc.name);
+	event.queue_idx = queue_idx;
+#endif
+#if defined(TINA_JOBS_TRACE) || defined(TINA_JOBS_NAME_STATS)
+	uint64_t run_begin = _TINA_TIMESTAMP();
+#endif
+	
+	// Jobs can run nested if they call tina_scheduler_run(), so restore the outer job afterwards.
+	tina_job* outer_job = _TINA_THREAD_JOB;
+	_TINA_THREAD_JOB = job;
+	_tina_cache_worker(worker);
+	
 	_TINA_PROFILE_ENTER(job);
 	_tina_job_status status = (_tina_job_status)tina_resume(job->fiber, (uintptr_t)job);
 	_TINA_PROFILE_LEAVE(job, status);
 	
+	_TINA_THREAD_JOB = outer_job;
+	_tina_cache_worker(worker);
+	
+#if defined(TINA_JOBS_TRACE) || defined(TINA_JOBS_NAME_STATS)
+	uint64_t run_end = _TINA_TIMESTAMP();
+#endif
+#ifdef TINA_JOBS_TRACE
+	event.next_queue_idx = job->desc.queue_idx;
+	event.status = status;
+	event.begin = run_begin, event.end = run_end;
+#endif
+	
 	switch(status){
 		case _TINA_STATUS_COMPLETED: {
-			_TINA_MUTEX_LOCK(sched->_lock);
-			// Return the components to the pools.
-			sched->_job_pool.arr[sched->_job_pool.count++] = job;
-			sched->_fibers.arr[sched->_fibers.count++] = job->fiber;
+			_tina_scheduler_lock(sched);
+			// Return the components to their nodes' pools.
+			_tina_stack* job_pool = &sched->_job_pool[job->node];
+			job_pool->arr[job_pool->count++] = job;
+			_tina_stack* fibers = &sched->_fibers[job->fiber_node];
+			fibers->arr[fibers->count++] = job->fiber;
+			sched->_jobs_free++, sched->_fibers_free++;
 			
 			// Did it have a group, and was it the last job being waited for?
 			tina_group* group = job->group;
-			if(group) _tina_group_decrement(sched, group, 1);
+			if(group) _tina_group_decrement(sched, group, 1, worker->run_next_streak < _TINA_RUN_NEXT_LIMIT ? worker : NULL);
+			_TINA_PROBE(complete, job, job->desc.name, queue_idx, worker->idx);
 		} break;
 		case _TINA_STATUS_YIELDING:{
-			_TINA_MUTEX_LOCK(sched->_lock);
-			// Push the job to the back of the queue.
-			_tina_queue* queue = &sched->_queues[job->desc.queue_idx];
-			queue->arr[queue->head++ & queue->mask] = job;
-			_tina_queue_signal(queue);
+			_tina_scheduler_lock(sched);
+			_TINA_PROBE(suspend, job, job->desc.name, queue_idx, worker->idx, status);
+#ifdef TINA_JOBS_LATENCY
+			job->queue_time = _TINA_TIMESTAMP();
+#endif
+			// Push the job to the back of the queue on it's fiber's node.
+			_tina_scheduler_push(sched, job, job->fiber_node);
 		} break;
 		case _TINA_STATUS_WAITING: {
 			// Do nothing. The job will be re-enqueued when it's done waiting.
 			// tina_job_wait() locks the scheduler before yielding.
+			_TINA_PROBE(suspend, job, job->desc.name, queue_idx, worker->idx, status);
+		} break;
+	}
+	
+#ifdef TINA_JOBS_STATS
+	switch(status){
+		case _TINA_STATUS_COMPLETED: worker->stats.jobs_run++; break;
+		case _TINA_STATUS_WAITING: worker->stats.waits++; break;
+		case _TINA_STATUS_YIELDING: {
+			if(job->desc.queue_idx != queue_idx) worker->stats.queue_switches++; else worker->stats.yields++;
 		} break;
 	}
+#endif
+	
+#ifdef TINA_JOBS_NAME_STATS
+	tina_name_stats* name_stats = &sched->_name_stats[job->name_idx];
+	name_stats->cpu_time += run_end - run_begin;
+	if(status == _TINA_STATUS_COMPLETED){
+		name_stats->run_count++;
+		name_stats->wall_time += run_end - job->enqueue_time;
+	} else {
+		name_stats->suspend_count++;
+	}
+#endif
+	
+#ifdef TINA_JOBS_TRACE
+	// The scheduler is locked again anyway, so writing to the ring buffer doesn't cost an extra lock.
+	worker->trace[worker->trace_count++ & (_TINA_TRACE_CAPACITY - 1)] = event;
+#endif
+}
+
+// Get the next job for a worker to run from 'queue'. Scheduler must be locked.
+static tina_job* _tina_scheduler_next_job(tina_scheduler* sched, _tina_worker* worker, _tina_queue* queue){
+	// Jobs released by the last job go first, then jobs in the worker's private queue.
+	tina_job* job = worker->run_next;
+	if(job){
+		worker->run_next = NULL;
+		worker->run_next_streak++;
+	} else {
+		worker->run_next_streak = 0;
+		job = _tina_worker_next_job(worker);
+		if(job == NULL) job = _tina_queue_next_job(queue, worker->node, sched->_node_count);
+	}
+	return job;
+}
+
+// Run a queue. Scheduler must be locked.
+// TINA_RUN_LOOP exits once the queue's interrupt stamp no longer matches 'stamp'. All modes exit once 'until' is ready if it's not NULL.
+// TINA_RUN_BUDGET also exits after running 'max_jobs', or once the clock passes 'deadline'. Zero means no limit for either.
+static bool _tina_scheduler_run_locked(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode, unsigned stamp, const _tina_blocked* until, unsigned max_jobs, uint64_t deadline){
+	bool ran = false;
+	unsigned job_count = 0;
+	_tina_queue* queue = _tina_get_queue(sched, queue_idx);
+	_tina_worker* worker = _tina_scheduler_worker(sched);
+	
+	// Jobs can call tina_scheduler_run() to run another queue, so restore the outer one afterwards.
+	_tina_queue* outer_queue = worker->running;
+	worker->running = queue;
+	
+	// Keep looping until the interrupt stamp is incremented.
+	while((mode != TINA_RUN_LOOP || queue->interrupt_stamp == stamp) && !(until && _tina_blocked_ready(until))){
+		tina_job* job = _tina_scheduler_next_job(sched, worker, queue);
+		if(job){
+			_tina_scheduler_execute_job(sched, job, worker);
+			ran = true;
+			if(mode == TINA_RUN_SINGLE) break;
+			if(mode == TINA_RUN_BUDGET){
+				if(max_jobs && ++job_count >= max_jobs) break;
+				if(deadline && _TINA_TIMESTAMP() >= deadline) break;
+			}
+		} else if(mode == TINA_RUN_LOOP){
+			// Sleep until more work is added to the queue.
+			worker->parked = queue;
+			worker->parked_next = queue->parked_head;
+			queue->parked_head = worker;
+			queue->parked_count++;
+			_TINA_PROBE(worker_park, worker->idx, queue_idx);
+			_TINA_COND_WAIT(sched->_worker_signals[worker->idx], sched->_lock);
+			_TINA_PROBE(worker_unpark, worker->idx, queue_idx);
+			// Still parked if the wakeup was spurious.
+			if(worker->parked) _tina_worker_unpark(worker);
+		} else {
+			break;
+		}
+	}
+	
+	// Don't strand a job in the slot if the loop exits before running it.
+	if(worker->run_next){
+		_tina_scheduler_push(sched, worker->run_next, _tina_job_wake_node(worker->run_next));
+		worker->run_next = NULL;
+	}
+	// Once the outermost run returns, the worker can be given to another thread.
+	worker->running = outer_queue;
+	return ran;
+}
+
+// Run a queue. TINA_RUN_LOOP exits once the queue's interrupt stamp no longer matches 'stamp', or the current stamp if NULL.
+static bool _tina_scheduler_run(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode, const unsigned* stamp_ptr){
+	_tina_scheduler_lock(sched);
+	unsigned stamp = stamp_ptr ? *stamp_ptr : _tina_get_queue(sched, queue_idx)->interrupt_stamp;
+	bool ran = _tina_scheduler_run_locked(sched, queue_idx, mode, stamp, NULL, 0, 0);
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+	return ran;
+}
+
+bool tina_scheduler_run(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode){
+	_TINA_ASSERT(mode <= TINA_RUN_SINGLE, "Tina Jobs Error: Use tina_scheduler_run_limited() for this run mode.");
+	return _tina_scheduler_run(sched, queue_idx, mode, NULL);
+}
+
+bool tina_scheduler_run_limited(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode, const tina_run_limits* limits){
+	if(mode == TINA_RUN_UNTIL_GROUP){
+		_TINA_ASSERT(limits && limits->group, "Tina Jobs Error: TINA_RUN_UNTIL_GROUP requires a group.");
+		_tina_scheduler_lock(sched);
+		_tina_queue* queue = _tina_get_queue(sched, queue_idx);
+		// Register like a blocked thread so the group wakes this one up when the queue is empty.
+		_tina_blocked blocked = {.group = limits->group, .threshold = limits->threshold, .queue = queue, .next = NULL};
+		_tina_blocked_link(sched, &blocked);
+		bool ran = _tina_scheduler_run_locked(sched, queue_idx, TINA_RUN_LOOP, queue->interrupt_stamp, &blocked, 0, 0);
+		_tina_blocked_unlink(sched, &blocked);
+		_TINA_MUTEX_UNLOCK(sched->_lock);
+		return ran;
+	} else if(mode == TINA_RUN_BUDGET){
+		_TINA_ASSERT(limits, "Tina Jobs Error: TINA_RUN_BUDGET requires limits.");
+#ifdef _TINA_NO_TIMESTAMP
+		_TINA_ASSERT(limits->nanoseconds == 0, "Tina Jobs Error: TINA_RUN_BUDGET time limits need _TINA_TIMESTAMP() defined with TINA_NO_CRT.");
+#endif
+		uint64_t deadline = limits->nanoseconds ? _TINA_TIMESTAMP() + limits->nanoseconds : 0;
+		_tina_scheduler_lock(sched);
+		bool ran = _tina_scheduler_run_locked(sched, queue_idx, TINA_RUN_BUDGET, 0, NULL, limits->max_jobs, deadline);
+		_TINA_MUTEX_UNLOCK(sched->_lock);
+		return ran;
+	} else {
+		return _tina_scheduler_run(sched, queue_idx, mode, NULL);
+	}
+}
+
+void tina_scheduler_interrupt(tina_scheduler* sched, unsigned queue_idx){
+	_tina_scheduler_lock(sched); {
+		_tina_queue* queue = _tina_get_queue(sched, queue_idx);
+		queue->interrupt_stamp++;
+		_tina_queue_wake_all(queue);
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+#ifndef TINA_NO_CRT
+#include <stdio.h>
+#include <stdlib.h>
+
+// Read a sysfs list file like "0-3,6,8-11". Returns the number of values read.
+static unsigned _tina_read_list(const char* path, int* values, unsigned max){
+	unsigned count = 0;
+	FILE* f = fopen(path, "r");
+	if(f){
+		int first, last, c = ',';
+		while(c == ',' && fscanf(f, "%d", &first) == 1){
+			last = first;
+			c = fgetc(f);
+			if(c == '-' && fscanf(f, "%d", &last) == 1) c = fgetc(f);
+			for(int value = first; value <= last && count < max; value++) values[count++] = value;
+		}
+		fclose(f);
+	}
+	
+	return count;
+}
+
+unsigned tina_numa_node_count(void){
+	int nodes[TINA_MAX_NUMA_NODES];
+	unsigned count = _tina_read_list(_TINA_SYSFS_NODE "/online", nodes, TINA_MAX_NUMA_NODES);
+	// Node numbers are used as indexes, so count up to the highest one.
+	unsigned node_count = count ? (unsigned)nodes[count - 1] + 1 : 1;
+	return node_count < TINA_MAX_NUMA_NODES ? node_count : TINA_MAX_NUMA_NODES;
+}
+
+#ifndef TINA_JOBS_NO_WORKERS
+typedef struct {
+	int cpu, core, package, node;
+	// Index of the CPU within it's core, and the index of the core within it's package.
+	unsigned smt_rank, core_rank;
+} _tina_cpu_info;
+
+static bool _tina_read_topology(int cpu, const char* file, int* value){
+	char path[128];
+	snprintf(path, sizeof(path), _TINA_SYSFS_CPU "/cpu%d/topology/%s", cpu, file);
+	FILE* f = fopen(path, "r");
+	if(!f) return false;
+	
+	bool success = fscanf(f, "%d", value) == 1;
+	fclose(f);
+	return success;
+}
+
+// Read the online CPUs and their NUMA nodes from sysfs. Returns the number of CPUs found.
+static unsigned _tina_cpu_topology(_tina_cpu_info* cpus, unsigned max){
+	unsigned count = 0;
+	int list[_TINA_MAX_CPUS];
+	unsigned online = _tina_read_list(_TINA_SYSFS_CPU "/online", list, _TINA_MAX_CPUS);
+	for(unsigned i = 0; i < online && count < max; i++){
+		if(list[i] >= _TINA_MAX_CPUS) continue;
+		_tina_cpu_info info = {.cpu = list[i], .core = list[i], .package = 0, .node = 0, .smt_rank = 0, .core_rank = 0};
+		// Missing topology files aren't fatal, the CPU is treated as it's own core.
+		_tina_read_topology(info.cpu, "core_id", &info.core);
+		_tina_read_topology(info.cpu, "physical_package_id", &info.package);
+		cpus[count++] = info;
+	}
+	
+	if(count == 0){
+		// Topology isn't available. Assume each CPU is a separate core.
+		unsigned cpu_count = _TINA_CPU_COUNT();
+		if(cpu_count == 0) cpu_count = 1;
+		for(; count < cpu_count && count < max; count++){
+			cpus[count] = (_tina_cpu_info){.cpu = (int)count, .core = (int)count, .package = 0, .node = 0, .smt_rank = 0, .core_rank = 0};
+		}
+	}
+	
+	// CPUs not listed by any node stay on node 0.
+	int nodes[TINA_MAX_NUMA_NODES];
+	unsigned node_count = _tina_read_list(_TINA_SYSFS_NODE "/online", nodes, TINA_MAX_NUMA_NODES);
+	for(unsigned i = 0; i < node_count; i++){
+		char path[128];
+		snprintf(path, sizeof(path), _TINA_SYSFS_NODE "/node%d/cpulist", nodes[i]);
+		unsigned node_cpus = _tina_read_list(path, list, _TINA_MAX_CPUS);
+		for(unsigned j = 0; j < node_cpus; j++){
+			for(unsigned k = 0; k < count; k++) if(cpus[k].cpu == list[j]) cpus[k].node = nodes[i];
+		}
+	}
+	
+	return count;
+}
+
+static int _tina_cpu_compare_compact(const void* a, const void* b){
+	const _tina_cpu_info* x = (const _tina_cpu_info*)a;
+	const _tina_cpu_info* y = (const _tina_cpu_info*)b;
+	if(x->package != y->package) return x->package < y->package ? -1 : 1;
+	if(x->core != y->core) return x->core < y->core ? -1 : 1;
+	return x->cpu < y->cpu ? -1 : (x->cpu > y->cpu);
+}
+
+static int _tina_cpu_compare_scatter(const void* a, const void* b){
+	const _tina_cpu_info* x = (const _tina_cpu_info*)a;
+	const _tina_cpu_info* y = (const _tina_cpu_info*)b;
+	if(x->smt_rank != y->smt_rank) return x->smt_rank < y->smt_rank ? -1 : 1;
+	if(x->core_rank != y->core_rank) return x->core_rank < y->core_rank ? -1 : 1;
+	return x->package < y->package ? -1 : (x->package > y->package);
+}
+
+// Sort the CPUs into the order workers should be pinned for an affinity policy. Returns the number of usable CPUs.
+static unsigned _tina_cpu_order(_tina_cpu_info* cpus, unsigned count, tina_affinity affinity){
+	qsort(cpus, count, sizeof(*cpus), _tina_cpu_compare_compact);
+	for(unsigned i = 1; i < count; i++){
+		_tina_cpu_info* prev = &cpus[i - 1];
+		if(cpus[i].package != prev->package) continue;
+		
+		bool same_core = cpus[i].core == prev->core;
+		cpus[i].smt_rank = same_core ? prev->smt_rank + 1 : 0;
+		cpus[i].core_rank = same_core ? prev->core_rank : prev->core_rank + 1;
+	}
+	
+	if(affinity == TINA_AFFINITY_SCATTER){
+		qsort(cpus, count, sizeof(*cpus), _tina_cpu_compare_scatter);
+	} else if(affinity == TINA_AFFINITY_PHYSICAL){
+		unsigned cores = 0;
+		for(unsigned i = 0; i < count; i++){
+			if(cpus[i].smt_rank == 0) cpus[cores++] = cpus[i];
+		}
+		count = cores;
+	}
+	
+	return count;
+}
+
+typedef struct {
+	tina_workers* workers;
+	_TINA_THREAD_T thread;
+	unsigned idx;
+	// CPU and NUMA node the thread is pinned to, or -1.
+	int cpu, node;
+} _tina_worker_thread;
+
+struct tina_workers {
+	tina_scheduler* sched;
+	unsigned queue_idx;
+	// Interrupt stamp of the queue when the pool was started.
+	unsigned stamp;
+	char name[16];
+	unsigned count;
+	_tina_worker_thread* threads;
+};
+
+static int _tina_workers_body(void* data){
+	_tina_worker_thread* thread = (_tina_worker_thread*)data;
+	tina_workers* workers = thread->workers;
+	
+	// Linux limits names to 15 characters, so truncate the name to leave room for the index.
+	char digits[12], name[16];
+	int digit_count = snprintf(digits, sizeof(digits), "%u", thread->idx);
+	snprintf(name, sizeof(name), "%.*s%s", 15 - digit_count, workers->name, digits);
+	_TINA_THREAD_NAME(name);
+	if(thread->cpu >= 0) _TINA_THREAD_PIN(thread->cpu);
+	if(thread->node >= 0) tina_worker_set_node((unsigned)thread->node);
+	
+	// Use the stamp from when the pool started so tina_workers_stop() works even if the thread starts late.
+	_tina_scheduler_run(workers->sched, workers->queue_idx, TINA_RUN_LOOP, &workers->stamp);
+	return 0;
+}
+
+unsigned tina_workers_cpu_count(tina_affinity affinity){
+	_tina_cpu_info* cpus = (_tina_cpu_info*)malloc(_TINA_MAX_CPUS*sizeof(_tina_cpu_info));
+	if(!cpus) return 1;
+	unsigned cpu_count = _tina_cpu_topology(cpus, _TINA_MAX_CPUS);
+	cpu_count = _tina_cpu_order(cpus, cpu_count, affinity);
+	free(cpus);
+	return cpu_count;
+}
+
+tina_workers* tina_workers_start(tina_scheduler* sched, unsigned queue_idx, unsigned count, tina_affinity affinity, const char* name){
+	_tina_cpu_info* cpus = (_tina_cpu_info*)malloc(_TINA_MAX_CPUS*sizeof(_tina_cpu_info));
+	if(!cpus) return NULL;
+	unsigned cpu_count = _tina_cpu_topology(cpus, _TINA_MAX_CPUS);
+	cpu_count = _tina_cpu_order(cpus, cpu_count, affinity);
+	if(count == 0) count = cpu_count;
+	
+	unsigned stamp;
+	_tina_scheduler_lock(sched); {
+		// Reserve the workers up front so the threads can't run out of them, and leave one for the calling thread.
+		unsigned available = TINA_MAX_WORKERS - 1 - sched->_pool_threads;
+		if(count > available) count = available;
+		sched->_pool_threads += count;
+		stamp = _tina_get_queue(sched, queue_idx)->interrupt_stamp;
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+	
+	size_t header_size = _tina_jobs_align(sizeof(tina_workers));
+	tina_workers* workers = (tina_workers*)malloc(header_size + count*sizeof(_tina_worker_thread));
+	unsigned started = 0;
+	if(workers){
+		workers->sched = sched;
+		workers->queue_idx = queue_idx;
+		workers->stamp = stamp;
+		workers->threads = (_tina_worker_thread*)((uint8_t*)workers + header_size);
+		snprintf(workers->name, sizeof(workers->name), "%s", name ? name : "tina-worker");
+		
+		for(; started < count; started++){
+			_tina_worker_thread* thread = &workers->threads[started];
+			thread->workers = workers;
+			thread->idx = started;
+			// Wrap around if there are more workers than CPUs.
+			thread->cpu = affinity == TINA_AFFINITY_NONE ? -1 : cpus[started % cpu_count].cpu;
+			thread->node = affinity == TINA_AFFINITY_NONE ? -1 : cpus[started % cpu_count].node;
+			if(!_TINA_THREAD_CREATE(thread->thread, _tina_workers_body, thread)) break;
+		}
+		workers->count = started;
+	}
+	free(cpus);
+	
+	// Give back the workers reserved for threads that didn't start.
+	_tina_scheduler_lock(sched); {
+		sched->_pool_threads -= count - started;
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+	
+	if(started == 0){
+		free(workers);
+		return NULL;
+	}
+	return workers;
+}
+
+unsigned tina_workers_count(tina_workers* workers){return workers->count;}
+
+int tina_workers_cpu(tina_workers* workers, unsigned idx){
+	_TINA_ASSERT(idx < workers->count, "Tina Jobs Error: Invalid worker index.");
+	return workers->threads[idx].cpu;
+}
+
+void tina_workers_stop(tina_workers* workers){
+	tina_scheduler* sched = workers->sched;
+	tina_scheduler_interrupt(sched, workers->queue_idx);
+	for(unsigned i = 0; i < workers->count; i++) _TINA_THREAD_JOIN(workers->threads[i].thread);
+	
+	_tina_scheduler_lock(sched); {
+		sched->_pool_threads -= workers->count;
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+	free(workers);
+}
+#endif
+#endif
+
+void tina_scheduler_latency(tina_scheduler* sched, unsigned queue_idx, tina_queue_latency* latency, bool reset){
+#ifdef TINA_JOBS_LATENCY
+	_tina_scheduler_lock(sched); {
+		_tina_queue* queue = _tina_get_queue(sched, queue_idx);
+		(*latency) = queue->latency;
+		if(reset) _tina_latency_reset(&queue->latency);
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+#else
+	_tina_latency_reset(latency);
+#endif
+}
+
+#ifndef TINA_NO_CRT
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef TINA_JOBS_TRACE
+static void _tina_trace_write_string(FILE* file, const char* str){
+	fputc('"', file);
+	for(; *str; str++){
+		if(*str == '"' || *str == '\\') fputc('\\', file);
+		if((unsigned char)*str >= 0x20) fputc(*str, file);
+	}
+	fputc('"', file);
+}
+#endif
+
+bool tina_scheduler_trace_flush(tina_scheduler* sched, const char* filename){
+	FILE* file = fopen(filename, "w");
+	if(!file) return false;
+	
+	_tina_scheduler_lock(sched);
+	unsigned worker_count = sched->_worker_count;
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+	
+	bool success = true;
+	fputs("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [", file);
+	for(unsigned i = 0; i < worker_count; i++){
+		fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"args\": {\"name\": \"Worker %u\"}}", i ? "," : "", i, i);
+	}
+	
+#ifdef TINA_JOBS_TRACE
+	// Copy each worker's events out while holding the lock, but write them after unlocking so the workers aren't stuck waiting on the file.
+	_tina_trace_event* events = (_tina_trace_event*)malloc(_TINA_TRACE_CAPACITY*sizeof(_tina_trace_event));
+	success = events != NULL;
+	
+	static const char* STATUS_NAMES[] = {"completed", "wait", "yield"};
+	for(unsigned i = 0; events && i < worker_count; i++){
+		size_t count = 0;
+		_tina_scheduler_lock(sched); {
+			_tina_worker* worker = &sched->_workers[i];
+			// Only the most recent events are kept when the ring buffer wraps.
+			size_t first = worker->trace_count > _TINA_TRACE_CAPACITY ? worker->trace_count - _TINA_TRACE_CAPACITY : 0;
+			for(size_t j = first; j < worker->trace_count; j++) events[count++] = worker->trace[j & (_TINA_TRACE_CAPACITY - 1)];
+			worker->trace_count = 0;
+		} _TINA_MUTEX_UNLOCK(sched->_lock);
+		
+		for(size_t j = 0; j < count; j++){
+			const _tina_trace_event* event = &events[j];
+			bool switched = event->status == _TINA_STATUS_YIELDING && event->queue_idx != event->next_queue_idx;
+			
+			fputs(",\n{\"name\": ", file);
+			_tina_trace_write_string(file, event->name[0] ? event->name : "<no name>");
+			fprintf(file, ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, ",
+				switched ? "switch_queue" : STATUS_NAMES[event->status], i, event->begin/1e3, (event->end - event->begin)/1e3
+			);
+			fprintf(file, "\"args\": {\"queue\": %u, \"next_queue\": %u}}", event->queue_idx, event->next_queue_idx);
+		}
+	}
+	free(events);
+#endif
+	fputs("\n]}\n", file);
+	
+	return fclose(file) == 0 && success;
+}
+
+bool tina_scheduler_offcpu_flush(tina_scheduler* sched, const char* filename){
+	FILE* file = fopen(filename, "w");
+	if(!file) return false;
+	
+#ifdef TINA_JOBS_OFFCPU
+	_tina_scheduler_lock(sched); {
+		for(unsigned i = 0; i < _TINA_OFFCPU_SITES; i++){
+			_tina_offcpu_site* site = &sched->_offcpu_sites[i];
+			if(!site->used) continue;
+			
+			// Folded stacks start at the root, so write the job name and then the frames outermost first.
+			fputs(site->name ? site->name : "<no name>", file);
+			for(unsigned j = site->depth; j-- > 0;){
+				char symbol[256];
+				_TINA_SYMBOLIZE(site->stack[j], symbol, sizeof(symbol));
+				fprintf(file, ";%s", symbol);
+			}
+			fprintf(file, " %llu\n", (unsigned long long)site->time);
+			site->used = false;
+		}
+		
+		if(sched->_offcpu_dropped) fprintf(file, "<dropped> %llu\n", (unsigned long long)sched->_offcpu_dropped);
+		sched->_offcpu_dropped = 0;
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+#endif
+	
+	return fclose(file) == 0;
+}
+#endif
+
+#ifdef TINA_JOBS_STATS
+static inline void _tina_worker_stats_add(tina_worker_stats* sum, const tina_worker_stats* stats){
+	sum->jobs_run += stats->jobs_run;
+	sum->yields += stats->yields;
+	sum->waits += stats->waits;
+	sum->queue_switches += stats->queue_switches;
+	sum->lock_acquisitions += stats->lock_acquisitions;
+	sum->lock_contended += stats->lock_contended;
+}
+#endif
+
+void tina_scheduler_stats(tina_scheduler* sched, tina_stats* stats, unsigned* queue_lengths){
+	_tina_scheduler_lock(sched); {
+		stats->job_count = sched->_job_count;
+		stats->jobs_free = sched->_jobs_free;
+		stats->jobs_high_water = sched->_job_count - sched->_job_pool_low;
+		stats->fiber_count = sched->_fiber_count;
+		stats->fibers_free = sched->_fibers_free;
+		stats->fibers_high_water = sched->_fiber_count - sched->_fibers_low;
+		stats->jobs_waiting = sched->_waiting_count;
+		stats->workers = sched->_worker_count;
+		
+		stats->jobs_queued = stats->workers_parked = 0;
+		for(unsigned i = 0; i < sched->_queue_count; i++){
+			_tina_queue* queue = &sched->_queues[i];
+			unsigned length = 0;
+			for(unsigned node = 0; node < sched->_node_count; node++) length += (unsigned)(queue->shards[node].head - queue->shards[node].tail);
+			if(queue_lengths) queue_lengths[i] = length;
+			stats->jobs_queued += length;
+			stats->workers_parked += queue->parked_count;
+		}
+		for(unsigned i = 0; i < TINA_MAX_WORKERS; i++) stats->jobs_queued += sched->_workers[i].private_count;
+		
+#ifdef TINA_JOBS_STATS
+		// Aggregate the counters here so the workers never have to share them.
+		stats->total = sched->_external_stats;
+		for(unsigned i = 0; i < TINA_MAX_WORKERS; i++){
+			stats->worker[i] = sched->_workers[i].stats;
+			_tina_worker_stats_add(&stats->total, &stats->worker[i]);
+		}
+#else
+		stats->total = _TINA_WORKER_STATS_ZERO;
+		for(unsigned i = 0; i < TINA_MAX_WORKERS; i++) stats->worker[i] = _TINA_WORKER_STATS_ZERO;
+#endif
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+#ifdef TINA_JOBS_NAME_STATS
+static bool _tina_name_equals(const char* a, const char* b){
+	if(a == b) return true;
+	while(*a && *a == *b){a++; b++;}
+	return *a == *b;
+}
+
+// Find or add the stats entry for a name. Scheduler must be locked.
+static unsigned _tina_name_stats_intern(tina_scheduler* sched, const char* name){
+	if(name == NULL) name = "<no name>";
+	
+	// FNV-1a hash of the name so that identical strings at different addresses are merged.
+	uint32_t hash = 2166136261u;
+	for(const char* c = name; *c; c++) hash = (hash ^ (uint8_t)*c)*16777619u;
+	
+	const unsigned mask = _TINA_NAME_STATS_CAPACITY - 1;
+	for(unsigned i = 0; i < _TINA_NAME_STATS_CAPACITY; i++){
+		unsigned idx = (hash + i) & mask;
+		tina_name_stats* entry = &sched->_name_stats[idx];
+		if(entry->name == NULL) entry->name = name;
+		if(_tina_name_equals(entry->name, name)) return idx;
+	}
+	
+	// Table is full.
+	return _TINA_NAME_STATS_CAPACITY;
+}
+#endif
+
+unsigned tina_scheduler_name_stats(tina_scheduler* sched, tina_name_stats* stats, unsigned max, bool reset){
+	unsigned count = 0;
+#ifdef TINA_JOBS_NAME_STATS
+	_tina_scheduler_lock(sched); {
+		for(unsigned i = 0; i <= _TINA_NAME_STATS_CAPACITY; i++){
+			tina_name_stats* entry = &sched->_name_stats[i];
+			// Skip empty slots, and the overflow entry unless it was used.
+			if(entry->name == NULL || (i == _TINA_NAME_STATS_CAPACITY && entry->cpu_time == 0)) continue;
+			
+			if(count < max) stats[count++] = *entry;
+			// Keep the names since in flight jobs still reference them.
+			if(reset) (*entry) = (tina_name_stats){entry->name, 0, 0, 0, 0};
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+#endif
+	return count;
+}
+
+// Pop a job from the pool and initialize it. Scheduler must be locked, and there must be a free job.
+// 'now' is only used for instrumentation.
+static tina_job* _tina_job_new(tina_scheduler* sched, const tina_job_description* desc, tina_group* group, unsigned node, uint64_t now){
+	tina_job* job = (tina_job*)_tina_pool_pop(sched->_job_pool, sched->_node_count, &node);
+	if(sched->_job_pool_low > --sched->_jobs_free) sched->_job_pool_low = sched->_jobs_free;
+	(*job) = (tina_job){
+		.desc = *desc, .user_data = NULL, .fiber = NULL, .group = group, .wait_next = NULL, .wait_threshold = 0,
+		.node = node, .fiber_node = 0,
+		.for_func = NULL, .for_begin = 0, .for_end = 0, .for_grain = 0,
+		.graph = NULL, .graph_node = 0,
+#ifdef TINA_JOBS_LATENCY
+		.queue_time = now, .suspend_time = 0, .woken = false,
+#endif
+#ifdef TINA_JOBS_NAME_STATS
+		.name_idx = _tina_name_stats_intern(sched, desc->name), .enqueue_time = now,
+#endif
+#ifdef TINA_JOBS_OFFCPU
+		.offcpu_stack = {NULL}, .offcpu_depth = 0, .offcpu_time = 0, .offcpu_captured = false,
+#endif
+	};
+	(void)now;
+	return job;
+}
+
+// Current time for instrumented jobs, or 0 if nothing uses it.
+static inline uint64_t _tina_job_time(void){
+#if defined(TINA_JOBS_LATENCY) || defined(TINA_JOBS_NAME_STATS)
+	return _TINA_TIMESTAMP();
+#else
+	return 0;
+#endif
+}
+
+unsigned tina_scheduler_enqueue_batch(tina_scheduler* sched, const tina_job_description* list, unsigned count, tina_group* group, unsigned max_group_count){
+	_tina_scheduler_lock(sched); {
+		if(group) count = _tina_group_increment(group, count, max_group_count);
+		uint64_t now = _tina_job_time();
+		
+		_TINA_ASSERT(sched->_jobs_free >= count, "Tina Jobs Error: Ran out of jobs.");
+		// Queue the jobs on the calling thread's node.
+		unsigned node = _tina_thread_node(sched);
+		for(size_t i = 0; i < count; i++){
+			_TINA_ASSERT(list[i].func, "Tina Jobs Error: Job must have a body function.");
+			tina_job* job = _tina_job_new(sched, &list[i], group, node, now);
+			
+			// Push it to the proper queue.
+			_tina_scheduler_push(sched, job, node);
+			_TINA_PROBE(enqueue, job, list[i].name, list[i].queue_idx);
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+	
+	return count;
+}
+
+// Split the upper half of a parallel-for job's remaining range into a new job if there are idle threads to run it.
+// Not inlined into _tina_for_job() since it reads the thread's node, and the body may have resumed the job on another thread.
+static _TINA_NOINLINE void _tina_for_split(tina_scheduler* sched, tina_job* job){
+	// Only split at grain boundaries, and only if both halves get at least one chunk.
+	size_t remaining = job->for_end - job->for_begin;
+	size_t chunks = remaining/job->for_grain + (remaining%job->for_grain != 0);
+	if(chunks < 2 || (job->desc.queue_idx & TINA_WORKER_QUEUE_FLAG)) return;
+	
+	// Check without the lock first so busy workers don't contend for it before every chunk. A stale answer only delays or skips a split.
+	_tina_queue* queue = _tina_get_queue(sched, job->desc.queue_idx);
+	if(_TINA_ATOMIC_LOAD(&sched->_jobs_free) == 0 || !_tina_queue_has_idle(queue)) return;
+	
+	_tina_scheduler_lock(sched); {
+		if(sched->_jobs_free && _tina_queue_has_idle(queue)){
+			size_t mid = job->for_begin + (chunks/2)*job->for_grain;
+			unsigned node = _tina_thread_node(sched);
+			tina_job* half = _tina_job_new(sched, &job->desc, job->group, node, _tina_job_time());
+			half->for_func = job->for_func;
+			half->for_begin = mid, half->for_end = job->for_end, half->for_grain = job->for_grain;
+			job->for_end = mid;
+			
+			if(job->group) _tina_group_increment(job->group, 1, 0);
+			_tina_scheduler_push(sched, half, node);
+			_TINA_PROBE(enqueue, half, half->desc.name, half->desc.queue_idx);
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+static void _tina_for_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	while(job->for_begin < job->for_end){
+		_tina_for_split(sched, job);
+		
+		size_t begin = job->for_begin, end = job->for_end;
+		if(end - begin > job->for_grain) end = begin + job->for_grain;
+		job->for_begin = end;
+		job->for_func(job, job->desc.user_data, begin, end);
+	}
+}
+
+void tina_parallel_for(tina_scheduler* sched, size_t begin, size_t end, size_t grain, tina_for_func* func, void* ctx, unsigned queue_idx, tina_group* group){
+	_TINA_ASSERT(func, "Tina Jobs Error: Parallel-for must have a body function.");
+	_TINA_ASSERT(grain > 0, "Tina Jobs Error: Parallel-for grain must be non-zero.");
+	if(begin >= end) return;
+	
+	tina_job_description desc = {.name = "tina_parallel_for", .func = _tina_for_job, .user_data = ctx, .user_idx = 0, .queue_idx = queue_idx};
+	_tina_scheduler_lock(sched); {
+		if(group) _tina_group_increment(group, 1, 0);
+		_TINA_ASSERT(sched->_jobs_free > 0, "Tina Jobs Error: Ran out of jobs.");
+		unsigned node = _tina_thread_node(sched);
+		tina_job* job = _tina_job_new(sched, &desc, group, node, _tina_job_time());
+		job->for_func = func;
+		job->for_begin = begin, job->for_end = end, job->for_grain = grain;
+		
+		_tina_scheduler_push(sched, job, node);
+		_TINA_PROBE(enqueue, job, desc.name, queue_idx);
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+typedef struct {
+	const tina_reduce_description* desc;
+	// Cache line aligned accumulators, and the distance between them.
+	uint8_t* slots;
+	size_t stride;
+	// Distance between the pairs of accumulators to combine, and the number of accumulators. (tree reduction)
+	size_t step, count;
+	// Range being scanned, and the number of blocks it's split into. (scan)
+	size_t begin, length, blocks;
+} _tina_reduce_ctx;
+
+static inline void _tina_copy(void* dst, const void* src, size_t size){
+	uint8_t* d = (uint8_t*)dst;
+	const uint8_t* s = (const uint8_t*)src;
+	for(size_t i = 0; i < size; i++) d[i] = s[i];
+}
+
+static inline size_t _tina_slot_stride(size_t value_size){
+	return (value_size + _TINA_CACHE_LINE - 1) & ~(size_t)(_TINA_CACHE_LINE - 1);
+}
+
+static inline void* _tina_reduce_slot(const _tina_reduce_ctx* ctx, size_t idx){return ctx->slots + idx*ctx->stride;}
+
+static _tina_reduce_ctx _tina_reduce_ctx_init(const tina_reduce_description* desc, void* scratch){
+	_TINA_ASSERT(desc->fold && desc->combine && desc->identity, "Tina Jobs Error: Reductions require fold and combine functions and an identity.");
+	uintptr_t aligned = ((uintptr_t)scratch + _TINA_CACHE_LINE - 1) & ~(uintptr_t)(_TINA_CACHE_LINE - 1);
+	_tina_reduce_ctx ctx = {.desc = desc, .slots = (uint8_t*)aligned, .stride = _tina_slot_stride(desc->value_size), .step = 0, .count = 0, .begin = 0, .length = 0, .blocks = 0};
+	return ctx;
+}
+
+size_t tina_parallel_scratch_size(size_t value_size){
+	// An accumulator for each worker, two temporaries for scans, and padding to align it.
+	return (TINA_MAX_WORKERS + 2)*_tina_slot_stride(value_size) + _TINA_CACHE_LINE - 1;
+}
+
+static void _tina_reduce_fold(tina_job* job, void* ctx, size_t begin, size_t end){
+	const _tina_reduce_ctx* rctx = (const _tina_reduce_ctx*)ctx;
+	// The fold can't yield, so the job stays on this worker while it writes to the worker's accumulator.
+	// Previous chunks may have run on another thread though, so don't let the compiler reuse a thread local address from them.
+	void* acc = _tina_reduce_slot(rctx, tina_worker_index(tina_job_get_scheduler(job)));
+	rctx->desc->fold(rctx->desc->ctx, acc, begin, end);
+}
+
+static void _tina_reduce_pairs(tina_job* job, void* ctx, size_t begin, size_t end){
+	const _tina_reduce_ctx* rctx = (const _tina_reduce_ctx*)ctx;
+	for(size_t i = begin; i < end; i++){
+		size_t dst = 2*i*rctx->step, src = dst + rctx->step;
+		if(src < rctx->count) rctx->desc->combine(rctx->desc->ctx, _tina_reduce_slot(rctx, dst), _tina_reduce_slot(rctx, src));
+	}
+	(void)job;
+}
+
+void tina_parallel_reduce(tina_job* job, const tina_reduce_description* desc, size_t begin, size_t end, size_t grain, unsigned queue_idx, void* scratch, void* result){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_reduce_ctx ctx = _tina_reduce_ctx_init(desc, scratch);
+	for(unsigned i = 0; i < TINA_MAX_WORKERS; i++) _tina_copy(_tina_reduce_slot(&ctx, i), desc->identity, desc->value_size);
+	
+	tina_group group = {NULL, 0};
+	tina_parallel_for(sched, begin, end, grain, _tina_reduce_fold, &ctx, queue_idx, &group);
+	tina_job_wait_help(job, &group, 0);
+	
+	// Only workers that have started by now could have folded anything. Combine pairs of them until one is left.
+	// The worker count never shrinks, even when slots are recycled, so it covers every slot the fold wrote to.
+	ctx.count = tina_worker_count(sched);
+	for(ctx.step = 1; ctx.step < ctx.count; ctx.step *= 2){
+		tina_parallel_for(sched, 0, (ctx.count + ctx.step)/(2*ctx.step), 1, _tina_reduce_pairs, &ctx, queue_idx, &group);
+		tina_job_wait_help(job, &group, 0);
+	}
+	
+	_tina_copy(result, _tina_reduce_slot(&ctx, 0), desc->value_size);
+}
+
+// Get the range of a scan block. The blocks differ in length by at most one.
+static inline size_t _tina_scan_block(const _tina_reduce_ctx* ctx, size_t block, size_t* end){
+	size_t base = ctx->length/ctx->blocks, extra = ctx->length%ctx->blocks;
+	size_t begin = ctx->begin + block*base + (block < extra ? block : extra);
+	*end = begin + base + (block < extra);
+	return begin;
+}
+
+static void _tina_scan_fold(tina_job* job, void* ctx, size_t begin, size_t end){
+	const _tina_reduce_ctx* rctx = (const _tina_reduce_ctx*)ctx;
+	for(size_t block = begin; block < end; block++){
+		size_t block_end, block_begin = _tina_scan_block(rctx, block, &block_end);
+		rctx->desc->fold(rctx->desc->ctx, _tina_reduce_slot(rctx, block), block_begin, block_end);
+	}
+	(void)job;
+}
+
+static void _tina_scan_blocks(tina_job* job, void* ctx, size_t begin, size_t end){
+	const _tina_reduce_ctx* rctx = (const _tina_reduce_ctx*)ctx;
+	for(size_t block = begin; block < end; block++){
+		size_t block_end, block_begin = _tina_scan_block(rctx, block, &block_end);
+		rctx->desc->scan(rctx->desc->ctx, _tina_reduce_slot(rctx, block), block_begin, block_end);
+	}
+	(void)job;
+}
+
+void tina_parallel_scan(tina_job* job, const tina_reduce_description* desc, size_t begin, size_t end, size_t grain, unsigned queue_idx, void* scratch, void* result){
+	_TINA_ASSERT(desc->scan, "Tina Jobs Error: Scans require a scan function.");
+	_TINA_ASSERT(grain > 0, "Tina Jobs Error: Parallel-for grain must be non-zero.");
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_reduce_ctx ctx = _tina_reduce_ctx_init(desc, scratch);
+	ctx.begin = begin, ctx.length = end > begin ? end - begin : 0;
+	ctx.blocks = ctx.length/grain;
+	if(ctx.blocks > TINA_MAX_WORKERS) ctx.blocks = TINA_MAX_WORKERS;
+	if(ctx.blocks == 0 && ctx.length > 0) ctx.blocks = 1;
+	for(size_t i = 0; i < ctx.blocks; i++) _tina_copy(_tina_reduce_slot(&ctx, i), desc->identity, desc->value_size);
+	
+	// First pass: Fold the total of each block.
+	tina_group group = {NULL, 0};
+	tina_parallel_for(sched, 0, ctx.blocks, 1, _tina_scan_fold, &ctx, queue_idx, &group);
+	tina_job_wait_help(job, &group, 0);
+	
+	// Replace the block totals with the total of the blocks before them.
+	void* total = _tina_reduce_slot(&ctx, ctx.blocks);
+	void* tmp = _tina_reduce_slot(&ctx, ctx.blocks + 1);
+	_tina_copy(total, desc->identity, desc->value_size);
+	for(size_t i = 0; i < ctx.blocks; i++){
+		void* acc = _tina_reduce_slot(&ctx, i);
+		_tina_copy(tmp, acc, desc->value_size);
+		_tina_copy(acc, total, desc->value_size);
+		desc->combine(desc->ctx, total, tmp);
+	}
+	
+	// Second pass: Scan each block starting from it's prefix.
+	tina_parallel_for(sched, 0, ctx.blocks, 1, _tina_scan_blocks, &ctx, queue_idx, &group);
+	tina_job_wait_help(job, &group, 0);
+	
+	if(result) _tina_copy(result, total, desc->value_size);
 }
 
-bool tina_scheduler_run(tina_scheduler* sched, unsigned queue_idx, tina_run_mode mode){
-	bool ran = false;
-	_TINA_MUTEX_LOCK(sched->_lock); {
-		_tina_queue* queue = _tina_get_queue(sched, queue_idx);
-		
-		// Keep looping until the interrupt stamp is incremented.
-		unsigned stamp = queue->interrupt_stamp;
-		while(mode != TINA_RUN_LOOP || queue->interrupt_stamp == stamp){
-			tina_job* job = _tina_queue_next_job(queue);
-			if(job){
-				_tina_scheduler_execute_job(sched, job);
-				ran = true;
-				if(mode == TINA_RUN_SINGLE) break;
-			} else if(mode == TINA_RUN_LOOP){
-				// Sleep until more work is added to the queue.
-				queue->semaphore_count++;
-				_TINA_COND_WAIT(queue->semaphore_signal, sched->_lock);
-			} else {
-				break;
-			}
+#define _TINA_GRAPH_NO_EDGE (~0u)
+
+typedef struct {
+	tina_job_description desc;
+	// Number of edges into the node, and the number still incomplete in the current launch.
+	unsigned in_degree, pending;
+	// First edge out of the node, or _TINA_GRAPH_NO_EDGE.
+	unsigned first_edge;
+} _tina_graph_node;
+
+typedef struct {
+	// Node at the end of the edge, and the next edge out of the same node.
+	unsigned to, next;
+} _tina_graph_edge;
+
+struct tina_graph {
+	_tina_graph_node* nodes;
+	_tina_graph_edge* edges;
+	unsigned node_count, node_capacity;
+	unsigned edge_count, edge_capacity;
+	// Group passed to the current launch, and the number of nodes it has left to complete.
+	tina_group* group;
+	unsigned remaining;
+};
+
+size_t tina_graph_size(unsigned node_capacity, unsigned edge_capacity){
+	size_t size = 0;
+	size += _tina_jobs_align(sizeof(tina_graph));
+	size += _tina_jobs_align(node_capacity*sizeof(_tina_graph_node));
+	size += _tina_jobs_align(edge_capacity*sizeof(_tina_graph_edge));
+	return size;
+}
+
+tina_graph* tina_graph_init(void* _buffer, unsigned node_capacity, unsigned edge_capacity){
+	uint8_t* cursor = (uint8_t*)_buffer;
+	tina_graph* graph = (tina_graph*)cursor;
+	cursor += _tina_jobs_align(sizeof(tina_graph));
+	
+	(*graph) = (tina_graph){
+		.nodes = (_tina_graph_node*)cursor, .edges = NULL,
+		.node_count = 0, .node_capacity = node_capacity,
+		.edge_count = 0, .edge_capacity = edge_capacity,
+		.group = NULL, .remaining = 0,
+	};
+	cursor += _tina_jobs_align(node_capacity*sizeof(_tina_graph_node));
+	graph->edges = (_tina_graph_edge*)cursor;
+	
+	return graph;
+}
+
+#ifndef TINA_NO_CRT
+tina_graph* tina_graph_new(unsigned node_capacity, unsigned edge_capacity){
+	void* buffer = malloc(tina_graph_size(node_capacity, edge_capacity));
+	return tina_graph_init(buffer, node_capacity, edge_capacity);
+}
+
+void tina_graph_free(tina_graph* graph){
+	free(graph);
+}
+#endif
+
+unsigned tina_graph_add_node(tina_graph* graph, const tina_job_description* desc){
+	_TINA_ASSERT(graph->remaining == 0, "Tina Jobs Error: Graph can't be modified while it's running.");
+	_TINA_ASSERT(graph->node_count < graph->node_capacity, "Tina Jobs Error: Ran out of graph nodes.");
+	_TINA_ASSERT(desc->func, "Tina Jobs Error: Job must have a body function.");
+	unsigned idx = graph->node_count++;
+	graph->nodes[idx] = (_tina_graph_node){.desc = *desc, .in_degree = 0, .pending = 0, .first_edge = _TINA_GRAPH_NO_EDGE};
+	return idx;
+}
+
+void tina_graph_add_edge(tina_graph* graph, unsigned from, unsigned to){
+	_TINA_ASSERT(graph->remaining == 0, "Tina Jobs Error: Graph can't be modified while it's running.");
+	_TINA_ASSERT(graph->edge_count < graph->edge_capacity, "Tina Jobs Error: Ran out of graph edges.");
+	_TINA_ASSERT(from < graph->node_count && to < graph->node_count && from != to, "Tina Jobs Error: Invalid graph edge.");
+	unsigned idx = graph->edge_count++;
+	graph->edges[idx] = (_tina_graph_edge){.to = to, .next = graph->nodes[from].first_edge};
+	graph->nodes[from].first_edge = idx;
+	graph->nodes[to].in_degree++;
+}
+
+static void _tina_graph_job(tina_job* job);
+
+// Scheduler must be locked.
+static void _tina_graph_enqueue(tina_scheduler* sched, tina_graph* graph, unsigned idx, unsigned node){
+	_TINA_ASSERT(sched->_jobs_free > 0, "Tina Jobs Error: Ran out of jobs.");
+	tina_job_description desc = graph->nodes[idx].desc;
+	desc.func = _tina_graph_job;
+	tina_job* job = _tina_job_new(sched, &desc, graph->group, node, _tina_job_time());
+	job->graph = graph, job->graph_node = idx;
+	
+	_tina_scheduler_push(sched, job, node);
+	_TINA_PROBE(enqueue, job, desc.name, desc.queue_idx);
+}
+
+// Run a node's body, then release it's successors.
+static void _tina_graph_job(tina_job* job){
+	tina_graph* graph = job->graph;
+	const _tina_graph_node* node = &graph->nodes[job->graph_node];
+	node->desc.func(job);
+	
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched); {
+		graph->remaining--;
+		unsigned queue_node = _tina_thread_node(sched);
+		for(unsigned e = node->first_edge; e != _TINA_GRAPH_NO_EDGE; e = graph->edges[e].next){
+			unsigned to = graph->edges[e].to;
+			if(--graph->nodes[to].pending == 0) _tina_graph_enqueue(sched, graph, to, queue_node);
 		}
 	} _TINA_MUTEX_UNLOCK(sched->_lock);
-	return ran;
 }
 
-void tina_scheduler_interrupt(tina_scheduler* sched, unsigned queue_idx){
-	_TINA_MUTEX_LOCK(sched->_lock); {
-		_tina_queue* queue = _tina_get_queue(sched, queue_idx);
-		queue->interrupt_stamp++;
-		
-		_TINA_COND_BROADCAST(queue->semaphore_signal);
-		queue->semaphore_count = 0;
-	} _TINA_MUTEX_UNLOCK(sched->_lock);
+// Check that every node can be reached by Kahn's algorithm, using the pending counters as scratch space.
+// Nodes that have been visited are marked with a pending count that can't happen otherwise.
+static inline bool _tina_graph_is_acyclic(tina_graph* graph){
+	for(unsigned i = 0; i < graph->node_count; i++) graph->nodes[i].pending = graph->nodes[i].in_degree;
+	
+	unsigned visited = 0;
+	for(bool progress = true; progress;){
+		progress = false;
+		for(unsigned i = 0; i < graph->node_count; i++){
+			if(graph->nodes[i].pending) continue;
+			graph->nodes[i].pending = ~0u;
+			visited++, progress = true;
+			for(unsigned e = graph->nodes[i].first_edge; e != _TINA_GRAPH_NO_EDGE; e = graph->edges[e].next) graph->nodes[graph->edges[e].to].pending--;
+		}
+	}
+	return visited == graph->node_count;
 }
 
-unsigned tina_scheduler_enqueue_batch(tina_scheduler* sched, const tina_job_description* list, unsigned count, tina_group* group, unsigned max_group_count){
-	_TINA_MUTEX_LOCK(sched->_lock); {
-		if(group) count = _tina_group_increment(group, count, max_group_count);
+void tina_graph_launch(tina_scheduler* sched, tina_graph* graph, tina_group* group){
+	_tina_scheduler_lock(sched); {
+		_TINA_ASSERT(graph->remaining == 0, "Tina Jobs Error: Graph is already running.");
+		_TINA_ASSERT(_tina_graph_is_acyclic(graph), "Tina Jobs Error: Graph has a cycle.");
+		graph->group = group;
+		graph->remaining = graph->node_count;
+		if(group) _tina_group_increment(group, graph->node_count, 0);
 		
-		_TINA_ASSERT(sched->_job_pool.count >= count, "Tina Jobs Error: Ran out of jobs.");
-		for(size_t i = 0; i < count; i++){
-			_TINA_ASSERT(list[i].func, "Tina Jobs Error: Job must have a body function.");
-			
-			// Pop a job from the pool.
-			tina_job* job = (tina_job*)sched->_job_pool.arr[--sched->_job_pool.count];
-			(*job) = (tina_job){.desc = list[i], .user_data = NULL, .fiber = NULL, .group = group, .wait_next = NULL, .wait_threshold = 0};
-			
-			// Push it to the proper queue.
-			_tina_queue* queue = _tina_get_queue(sched, list[i].queue_idx);
-			queue->arr[queue->head++ & queue->mask] = job;
-			_tina_queue_signal(queue);
+		// Reset the counters before enqueueing anything.
+		for(unsigned i = 0; i < graph->node_count; i++) graph->nodes[i].pending = graph->nodes[i].in_degree;
+		
+		unsigned node = _tina_thread_node(sched);
+		for(unsigned i = 0; i < graph->node_count; i++){
+			if(graph->nodes[i].in_degree == 0) _tina_graph_enqueue(sched, graph, i, node);
 		}
 	} _TINA_MUTEX_UNLOCK(sched->_lock);
-	
-	return count;
 }
 
-unsigned tina_job_wait(tina_job* job, tina_group* group, unsigned threshold){
-	_TINA_MUTEX_LOCK(tina_job_get_scheduler(job)->_lock);
-	
+// Scheduler must be locked, and is unlocked when it returns.
+static unsigned _tina_job_wait(tina_scheduler* sched, tina_job* job, tina_group* group, unsigned threshold){
 	// Check if we need to wait at all.
 	unsigned count = group->_count;
 	if(count > threshold){
@@ -473,18 +2698,72 @@ unsigned tina_job_wait(tina_job* job, tina_group* group, unsigned threshold){
 		group->_job_list = job;
 		
 		job->wait_threshold = threshold;
+		sched->_waiting_count++;
+		_TINA_PROBE(group_wait, job, group, count, threshold);
+#ifdef TINA_JOBS_LATENCY
+		job->suspend_time = _TINA_TIMESTAMP();
+#endif
+#ifdef TINA_JOBS_OFFCPU
+		_tina_offcpu_capture(job);
+#endif
 		// NOTE: Scheduler will be unlocked after yielding.
 		tina_yield(job->fiber, _TINA_STATUS_WAITING);
 		job->wait_threshold = 0;
 		
 		return group->_count;
 	} else {
-		_TINA_MUTEX_UNLOCK(tina_job_get_scheduler(job)->_lock);
+		_TINA_MUTEX_UNLOCK(sched->_lock);
 		return count;
 	}
 }
 
+unsigned tina_job_wait(tina_job* job, tina_group* group, unsigned threshold){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched);
+	return _tina_job_wait(sched, job, group, threshold);
+}
+
+// Find a job to run while waiting on a group. Scheduler must be locked.
+static tina_job* _tina_scheduler_help_job(tina_scheduler* sched, _tina_worker* worker, tina_group* group){
+	// The newest job in the worker's own shard is most likely a child of the waiting job, and still warm in the cache.
+	for(_tina_queue* queue = worker->running; queue; queue = queue->fallback){
+		_tina_ring* ring = &queue->shards[worker->node];
+		if(ring->head == ring->tail) continue;
+		
+		tina_job* newest = (tina_job*)ring->arr[(ring->head - 1) & ring->mask];
+		if(newest->group == group){
+			ring->head--;
+			return newest;
+		}
+	}
+	
+	// Limit how deep unrelated jobs nest, since they can wait or help in turn.
+	if(worker->help_depth >= _TINA_HELP_DEPTH) return NULL;
+	return _tina_scheduler_next_job(sched, worker, worker->running);
+}
+
+unsigned tina_job_wait_help(tina_job* job, tina_group* group, unsigned threshold){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched);
+	
+	// Run jobs nested on this job's fiber. They get their own fibers, so they can still wait or yield without blocking this one.
+	_tina_worker* worker = _tina_cached_worker(sched);
+	while(worker && group->_count > threshold){
+		tina_job* help = _tina_scheduler_help_job(sched, worker, group);
+		if(help == NULL) break;
+		worker->help_depth++;
+		_tina_scheduler_execute_job(sched, help, worker);
+		worker->help_depth--;
+	}
+	
+	// Suspend normally if there wasn't enough work to help with.
+	return _tina_job_wait(sched, job, group, threshold);
+}
+
 void tina_job_yield(tina_job* job){
+#ifdef TINA_JOBS_OFFCPU
+	_tina_offcpu_capture(job);
+#endif
 	tina_yield(job->fiber, _TINA_STATUS_YIELDING);
 }
 
@@ -493,24 +2772,564 @@ unsigned tina_job_switch_queue(tina_job* job, unsigned queue_idx){
 	if(queue_idx == old_queue) return queue_idx;
 	
 	job->desc.queue_idx = queue_idx;
+#ifdef TINA_JOBS_OFFCPU
+	_tina_offcpu_capture(job);
+#endif
 	tina_yield(job->fiber, _TINA_STATUS_YIELDING);
 	return old_queue;
 }
 
 unsigned tina_group_increment(tina_scheduler* scheduler, tina_group* group, unsigned count, unsigned max_count){
-	_TINA_MUTEX_LOCK(scheduler->_lock);
+	_tina_scheduler_lock(scheduler);
 	count = _tina_group_increment(group, count, max_count);
 	_TINA_MUTEX_UNLOCK(scheduler->_lock);
 	return count;
 }
 
 void tina_group_decrement(tina_scheduler* scheduler, tina_group* group, unsigned count){
-	_TINA_MUTEX_LOCK(scheduler->_lock);
+	_tina_scheduler_lock(scheduler);
 	_TINA_ASSERT(group->_count >= count, "Tina Jobs Error: Group count underflow.");
-	_tina_group_decrement(scheduler, group, count);
+	_tina_group_decrement(scheduler, group, count, NULL);
 	_TINA_MUTEX_UNLOCK(scheduler->_lock);
 }
 
+// Scheduler must be locked.
+static void _tina_group_then(tina_scheduler* sched, tina_group* group, unsigned threshold, const tina_job_description* desc){
+	_TINA_ASSERT(desc->func, "Tina Jobs Error: Job must have a body function.");
+	_TINA_ASSERT(sched->_jobs_free > 0, "Tina Jobs Error: Ran out of jobs.");
+	unsigned node = _tina_thread_node(sched);
+	tina_job* job = _tina_job_new(sched, desc, NULL, node, _tina_job_time());
+	
+	unsigned count = group->_count;
+	if(count > threshold){
+		// Park it on the wait list like a waiting job. Releasing it pushes it to it's queue.
+		job->wait_next = group->_job_list;
+		group->_job_list = job;
+		job->wait_threshold = threshold;
+		sched->_waiting_count++;
+		_TINA_PROBE(group_wait, job, group, count, threshold);
+	} else {
+		_tina_scheduler_push(sched, job, node);
+		_TINA_PROBE(enqueue, job, desc->name, desc->queue_idx);
+	}
+}
+
+void tina_group_then(tina_scheduler* sched, tina_group* group, unsigned threshold, const tina_job_description* desc){
+	_tina_scheduler_lock(sched);
+	_tina_group_then(sched, group, threshold, desc);
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+// Append a job to the back of a wait list, and suspend it until it's woken with _tina_job_wake().
+// Scheduler must be locked, and will be unlocked after yielding. 'lock' is optional, and is unlocked once the job is on the list.
+static void _tina_job_park(tina_scheduler* sched, tina_job* job, tina_job** head, tina_job** tail, _TINA_MUTEX_T* lock){
+	job->wait_next = NULL;
+	if(*tail) (*tail)->wait_next = job; else *head = job;
+	*tail = job;
+	if(lock) _TINA_MUTEX_UNLOCK(*lock);
+	sched->_waiting_count++;
+#ifdef TINA_JOBS_LATENCY
+	job->suspend_time = _TINA_TIMESTAMP();
+#endif
+#ifdef TINA_JOBS_OFFCPU
+	_tina_offcpu_capture(job);
+#endif
+	tina_yield(job->fiber, _TINA_STATUS_WAITING);
+}
+
+bool tina_job_mutex_try_lock(tina_job_mutex* mutex){
+	return _TINA_ATOMIC_CAS(&mutex->_state, 0u, 1u);
+}
+
+// Mutex states. Unlocking a contended mutex needs to take the scheduler lock to check for waiters.
+enum {_TINA_MUTEX_UNLOCKED, _TINA_MUTEX_LOCKED, _TINA_MUTEX_CONTENDED};
+
+void tina_job_mutex_lock(tina_job* job, tina_job_mutex* mutex){
+	// Spin for a bit in case it's only held briefly.
+	for(unsigned i = 0; i < _TINA_JOB_MUTEX_SPIN; i++){
+		if(_TINA_ATOMIC_LOAD(&mutex->_state) == _TINA_MUTEX_UNLOCKED && tina_job_mutex_try_lock(mutex)) return;
+		_TINA_SPIN_PAUSE();
+	}
+	
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched);
+	// Mark it as contended so the unlock checks for waiters. If it was unlocked in the meantime, it's ours now.
+	if(_TINA_ATOMIC_EXCHANGE(&mutex->_state, _TINA_MUTEX_CONTENDED) == _TINA_MUTEX_UNLOCKED){
+		_TINA_MUTEX_UNLOCK(sched->_lock);
+		return;
+	}
+	
+	// Suspend until the lock is handed over.
+	_tina_job_park(sched, job, &mutex->_wait_head, &mutex->_wait_tail, NULL);
+}
+
+void tina_job_mutex_unlock(tina_job* job, tina_job_mutex* mutex){
+	// Fast path when nothing has waited on it.
+	if(_TINA_ATOMIC_CAS(&mutex->_state, _TINA_MUTEX_LOCKED, _TINA_MUTEX_UNLOCKED)) return;
+	
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched); {
+		tina_job* waiter = mutex->_wait_head;
+		if(waiter){
+			// Hand the lock to the next waiter. It stays locked, so nothing can barge in ahead of it.
+			mutex->_wait_head = waiter->wait_next;
+			if(mutex->_wait_head == NULL){
+				mutex->_wait_tail = NULL;
+				_TINA_ATOMIC_STORE(&mutex->_state, _TINA_MUTEX_LOCKED);
+			}
+			_tina_worker* worker = _tina_cached_worker(sched);
+			_tina_job_wake(sched, waiter, worker && worker->run_next_streak < _TINA_RUN_NEXT_LIMIT ? worker : NULL);
+		} else {
+			_TINA_ATOMIC_STORE(&mutex->_state, _TINA_MUTEX_UNLOCKED);
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+// Reader count for the calling thread's worker, or the shared one if it isn't running 'sched'.
+static inline unsigned* _tina_rwlock_slot(tina_scheduler* sched, tina_job_rwlock* rwlock){
+	_tina_worker* worker = _tina_cached_worker(sched);
+	return &rwlock->_readers[worker ? worker->idx : TINA_MAX_WORKERS].count;
+}
+
+// Individual counters can wrap, and the lock can outlive a scheduler, so sum all of them.
+static unsigned _tina_rwlock_readers(tina_job_rwlock* rwlock){
+	unsigned count = 0;
+	for(unsigned i = 0; i <= TINA_MAX_WORKERS; i++) count += _TINA_ATOMIC_LOAD(&rwlock->_readers[i].count);
+	return count;
+}
+
+// Pass the lock to whoever is next if it's free. Scheduler must be locked.
+static void _tina_rwlock_grant(tina_scheduler* sched, tina_job_rwlock* rwlock){
+	if(rwlock->_writing) return;
+	
+	tina_job* job = rwlock->_write_head;
+	if(job){
+		// Writers go first, but have to wait for the readers to drain.
+		if(_tina_rwlock_readers(rwlock)) return;
+		rwlock->_write_head = job->wait_next;
+		if(rwlock->_write_head == NULL) rwlock->_write_tail = NULL;
+		rwlock->_writing = true;
+		_tina_worker* worker = _tina_cached_worker(sched);
+		_tina_job_wake(sched, job, worker && worker->run_next_streak < _TINA_RUN_NEXT_LIMIT ? worker : NULL);
+	} else if(rwlock->_read_head){
+		// No writers left, so wake all the readers. They are counted on this worker until they unlock.
+		unsigned count = 0;
+		for(job = rwlock->_read_head; job; job = job->wait_next) count++;
+		_TINA_ATOMIC_ADD(_tina_rwlock_slot(sched, rwlock), count);
+		
+		while((job = rwlock->_read_head)){
+			rwlock->_read_head = job->wait_next;
+			_tina_job_wake(sched, job, NULL);
+		}
+		rwlock->_read_tail = NULL;
+	}
+}
+
+void tina_job_rwlock_read_lock(tina_job* job, tina_job_rwlock* rwlock){
+	// Fast path: Count the reader, then check that no writer got in first.
+	// Writers set '_writers' before summing the counts, so one side always sees the other.
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	unsigned* slot = _tina_rwlock_slot(sched, rwlock);
+	_TINA_ATOMIC_ADD(slot, 1u);
+	if(_TINA_ATOMIC_LOAD(&rwlock->_writers) == 0) return;
+	
+	// Back out again. A writer may have been waiting on this reader to drain.
+	_TINA_ATOMIC_ADD(slot, ~0u);
+	_tina_scheduler_lock(sched);
+	if(rwlock->_writers == 0){
+		// The writers finished in the meantime. New ones have to lock the scheduler first, so they will see this count.
+		_TINA_ATOMIC_ADD(slot, 1u);
+		_TINA_MUTEX_UNLOCK(sched->_lock);
+		return;
+	}
+	
+	_tina_rwlock_grant(sched, rwlock);
+	// Suspend until the last writer unlocks.
+	_tina_job_park(sched, job, &rwlock->_read_head, &rwlock->_read_tail, NULL);
+}
+
+void tina_job_rwlock_read_unlock(tina_job* job, tina_job_rwlock* rwlock){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_TINA_ATOMIC_ADD(_tina_rwlock_slot(sched, rwlock), ~0u);
+	if(_TINA_ATOMIC_LOAD(&rwlock->_writers) == 0) return;
+	
+	// A writer might be waiting for this reader.
+	_tina_scheduler_lock(sched);
+	_tina_rwlock_grant(sched, rwlock);
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+void tina_job_rwlock_write_lock(tina_job* job, tina_job_rwlock* rwlock){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched);
+	// Stop new readers from taking the fast path before checking for existing ones.
+	_TINA_ATOMIC_ADD(&rwlock->_writers, 1u);
+	if(!rwlock->_writing && rwlock->_write_head == NULL && _tina_rwlock_readers(rwlock) == 0){
+		rwlock->_writing = true;
+		_TINA_MUTEX_UNLOCK(sched->_lock);
+		return;
+	}
+	
+	// Suspend until the lock is handed over.
+	_tina_job_park(sched, job, &rwlock->_write_head, &rwlock->_write_tail, NULL);
+}
+
+void tina_job_rwlock_write_unlock(tina_job* job, tina_job_rwlock* rwlock){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched); {
+		_TINA_ASSERT(rwlock->_writing, "Tina Jobs Error: Reader-writer lock is not locked for writing.");
+		rwlock->_writing = false;
+		_TINA_ATOMIC_ADD(&rwlock->_writers, ~0u);
+		_tina_rwlock_grant(sched, rwlock);
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+// Set in a semaphore's permit count while jobs are waiting, so the fast paths leave the permits to the wait list.
+#define _TINA_SEMAPHORE_WAITING 0x80000000u
+
+void tina_job_semaphore_init(tina_job_semaphore* sem, unsigned permits){
+	_TINA_ASSERT(permits < _TINA_SEMAPHORE_WAITING, "Tina Jobs Error: Too many semaphore permits.");
+	*sem = (tina_job_semaphore){._permits = permits, ._wait_head = NULL, ._wait_tail = NULL};
+}
+
+bool tina_job_semaphore_try_acquire(tina_job_semaphore* sem, unsigned count){
+	unsigned permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+	// Retry only if another job changed the count and it could still succeed.
+	while(permits >= count && (permits & _TINA_SEMAPHORE_WAITING) == 0){
+		if(_TINA_ATOMIC_CAS(&sem->_permits, permits, permits - count)) return true;
+		permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+	}
+	return false;
+}
+
+void tina_job_semaphore_acquire(tina_job* job, tina_job_semaphore* sem, unsigned count){
+	if(tina_job_semaphore_try_acquire(sem, count)) return;
+	
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched);
+	// Try again, otherwise set the waiting flag. Releases add to the count first, so they will see it and lock the scheduler.
+	unsigned permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+	while(true){
+		if(permits >= count && (permits & _TINA_SEMAPHORE_WAITING) == 0){
+			if(_TINA_ATOMIC_CAS(&sem->_permits, permits, permits - count)){
+				_TINA_MUTEX_UNLOCK(sched->_lock);
+				return;
+			}
+		} else if(_TINA_ATOMIC_CAS(&sem->_permits, permits, permits | _TINA_SEMAPHORE_WAITING)){
+			break;
+		}
+		permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+	}
+	
+	// Suspend until a release hands over the permits.
+	job->wait_threshold = count;
+	_tina_job_park(sched, job, &sem->_wait_head, &sem->_wait_tail, NULL);
+}
+
+void tina_job_semaphore_release(tina_scheduler* sched, tina_job_semaphore* sem, unsigned count){
+	// Fast path when nothing is waiting.
+	if((_TINA_ATOMIC_ADD(&sem->_permits, count) & _TINA_SEMAPHORE_WAITING) == 0) return;
+	
+	_tina_scheduler_lock(sched); {
+		// Hand permits to the waiters in order until the next one needs more than are available.
+		tina_job* job;
+		while((job = sem->_wait_head)){
+			unsigned permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+			if((permits & ~_TINA_SEMAPHORE_WAITING) < job->wait_threshold) break;
+			// Only releases can change the count while the flag is set, so retry until it sticks.
+			if(!_TINA_ATOMIC_CAS(&sem->_permits, permits, permits - job->wait_threshold)) continue;
+			
+			sem->_wait_head = job->wait_next;
+			_tina_job_wake(sched, job, NULL);
+		}
+		
+		if(sem->_wait_head == NULL){
+			sem->_wait_tail = NULL;
+			// Let the fast paths have the permits again. Releases can still race with this.
+			unsigned permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+			while(!_TINA_ATOMIC_CAS(&sem->_permits, permits, permits & ~_TINA_SEMAPHORE_WAITING)) permits = _TINA_ATOMIC_LOAD(&sem->_permits);
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+struct tina_channel {
+	// Protects everything below. The scheduler is only locked to suspend or wake jobs.
+	_TINA_MUTEX_T lock;
+	uint8_t* buffer;
+	size_t element_size, capacity;
+	// Index of the oldest element, and the number of elements in the buffer.
+	size_t head, count;
+	bool closed;
+	tina_job* send_head;
+	tina_job* send_tail;
+	tina_job* recv_head;
+	tina_job* recv_tail;
+};
+
+size_t tina_channel_size(size_t element_size, size_t capacity){
+	return _tina_jobs_align(sizeof(tina_channel)) + capacity*element_size;
+}
+
+tina_channel* tina_channel_init(void* _buffer, size_t element_size, size_t capacity){
+	_TINA_ASSERT(element_size > 0 && capacity > 0, "Tina Jobs Error: Channel elements and capacity must not be empty.");
+	uint8_t* cursor = (uint8_t*)_buffer;
+	tina_channel* chan = (tina_channel*)cursor;
+	cursor += _tina_jobs_align(sizeof(tina_channel));
+	
+	_TINA_MUTEX_INIT(chan->lock);
+	chan->buffer = cursor;
+	chan->element_size = element_size, chan->capacity = capacity;
+	chan->head = chan->count = 0;
+	chan->closed = false;
+	chan->send_head = chan->send_tail = NULL;
+	chan->recv_head = chan->recv_tail = NULL;
+	
+	return chan;
+}
+
+void tina_channel_destroy(tina_channel* chan){
+	_TINA_ASSERT(chan->send_head == NULL && chan->recv_head == NULL, "Tina Jobs Error: Jobs are still waiting on the channel.");
+	_TINA_MUTEX_DESTROY(chan->lock);
+}
+
+#ifndef TINA_NO_CRT
+tina_channel* tina_channel_new(size_t element_size, size_t capacity){
+	void* buffer = malloc(tina_channel_size(element_size, capacity));
+	return tina_channel_init(buffer, element_size, capacity);
+}
+
+void tina_channel_free(tina_channel* chan){
+	tina_channel_destroy(chan);
+	free(chan);
+}
+#endif
+
+// Copy elements into the ring buffer in at most two runs. Returns the number copied. Channel must be locked.
+static size_t _tina_channel_push(tina_channel* chan, const uint8_t* elements, size_t count){
+	if(count > chan->capacity - chan->count) count = chan->capacity - chan->count;
+	size_t tail = (chan->head + chan->count) % chan->capacity;
+	size_t run = chan->capacity - tail < count ? chan->capacity - tail : count;
+	_tina_copy(chan->buffer + tail*chan->element_size, elements, run*chan->element_size);
+	_tina_copy(chan->buffer, elements + run*chan->element_size, (count - run)*chan->element_size);
+	chan->count += count;
+	return count;
+}
+
+// Copy elements out of the ring buffer in at most two runs. Returns the number copied. Channel must be locked.
+static size_t _tina_channel_pop(tina_channel* chan, uint8_t* elements, size_t count){
+	if(count > chan->count) count = chan->count;
+	size_t run = chan->capacity - chan->head < count ? chan->capacity - chan->head : count;
+	_tina_copy(elements, chan->buffer + chan->head*chan->element_size, run*chan->element_size);
+	_tina_copy(elements + run*chan->element_size, chan->buffer, (count - run)*chan->element_size);
+	chan->head = (chan->head + count) % chan->capacity;
+	chan->count -= count;
+	return count;
+}
+
+static void _tina_channel_wake_one(tina_scheduler* sched, tina_job** head, tina_job** tail){
+	tina_job* job = *head;
+	*head = job->wait_next;
+	if(*head == NULL) *tail = NULL;
+	_tina_job_wake(sched, job, NULL);
+}
+
+// Wake a receiver if there are elements, and a sender if there's room. Each one wakes the next if there's still more to do.
+// Closing wakes everything so they can return. Channel must be locked.
+static void _tina_channel_signal(tina_scheduler* sched, tina_channel* chan){
+	bool wake_send = chan->send_head && (chan->count < chan->capacity || chan->closed);
+	bool wake_recv = chan->recv_head && (chan->count > 0 || chan->closed);
+	if(!wake_send && !wake_recv) return;
+	
+	_tina_scheduler_lock(sched); {
+		if(chan->closed){
+			while(chan->send_head) _tina_channel_wake_one(sched, &chan->send_head, &chan->send_tail);
+			while(chan->recv_head) _tina_channel_wake_one(sched, &chan->recv_head, &chan->recv_tail);
+		} else {
+			if(wake_send) _tina_channel_wake_one(sched, &chan->send_head, &chan->send_tail);
+			if(wake_recv) _tina_channel_wake_one(sched, &chan->recv_head, &chan->recv_tail);
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+size_t tina_channel_send(tina_job* job, tina_channel* chan, const void* elements, size_t count){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	const uint8_t* cursor = (const uint8_t*)elements;
+	size_t sent = 0;
+	
+	_TINA_MUTEX_LOCK(chan->lock);
+	while(!chan->closed){
+		sent += _tina_channel_push(chan, cursor + sent*chan->element_size, count - sent);
+		if(sent == count) break;
+		
+		// Let the receivers at what was sent so far, and suspend until there is room.
+		_tina_channel_signal(sched, chan);
+		_tina_scheduler_lock(sched);
+		_tina_job_park(sched, job, &chan->send_head, &chan->send_tail, &chan->lock);
+		_TINA_MUTEX_LOCK(chan->lock);
+	}
+	_tina_channel_signal(sched, chan);
+	_TINA_MUTEX_UNLOCK(chan->lock);
+	
+	return sent;
+}
+
+size_t tina_channel_recv(tina_job* job, tina_channel* chan, void* elements, size_t count){
+	_TINA_ASSERT(count > 0, "Tina Jobs Error: Receiving zero elements from a channel can't be told apart from it being closed.");
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	size_t received = 0;
+	
+	_TINA_MUTEX_LOCK(chan->lock);
+	while(true){
+		received = _tina_channel_pop(chan, (uint8_t*)elements, count);
+		if(received || chan->closed) break;
+		
+		// Suspend until something is sent or the channel is closed.
+		_tina_scheduler_lock(sched);
+		_tina_job_park(sched, job, &chan->recv_head, &chan->recv_tail, &chan->lock);
+		_TINA_MUTEX_LOCK(chan->lock);
+	}
+	_tina_channel_signal(sched, chan);
+	_TINA_MUTEX_UNLOCK(chan->lock);
+	
+	return received;
+}
+
+size_t tina_channel_try_send(tina_scheduler* sched, tina_channel* chan, const void* elements, size_t count){
+	size_t sent = 0;
+	_TINA_MUTEX_LOCK(chan->lock); {
+		if(!chan->closed) sent = _tina_channel_push(chan, (const uint8_t*)elements, count);
+		_tina_channel_signal(sched, chan);
+	} _TINA_MUTEX_UNLOCK(chan->lock);
+	return sent;
+}
+
+size_t tina_channel_try_recv(tina_scheduler* sched, tina_channel* chan, void* elements, size_t count){
+	size_t received = 0;
+	_TINA_MUTEX_LOCK(chan->lock); {
+		received = _tina_channel_pop(chan, (uint8_t*)elements, count);
+		_tina_channel_signal(sched, chan);
+	} _TINA_MUTEX_UNLOCK(chan->lock);
+	return received;
+}
+
+void tina_channel_close(tina_scheduler* sched, tina_channel* chan){
+	_TINA_MUTEX_LOCK(chan->lock); {
+		chan->closed = true;
+		_tina_channel_signal(sched, chan);
+	} _TINA_MUTEX_UNLOCK(chan->lock);
+}
+
+// Scheduler must be locked.
+static void _tina_future_fulfill(tina_scheduler* sched, tina_future* future, uintptr_t value){
+	_TINA_ASSERT(!future->_ready, "Tina Jobs Error: Future was already fulfilled.");
+	future->_value = value;
+	_TINA_ATOMIC_STORE(&future->_ready, 1u);
+	// Release anything waiting on it's group.
+	if(future->_group._count) _tina_group_decrement(sched, &future->_group, 1, NULL);
+}
+
+// Let jobs wait on a pending future's group. Scheduler must be locked.
+static inline void _tina_future_pend(tina_future* future){
+	future->_group._count = 1;
+}
+
+void tina_future_fulfill(tina_scheduler* sched, tina_future* future, uintptr_t value){
+	_tina_scheduler_lock(sched);
+	_tina_future_fulfill(sched, future, value);
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+bool tina_future_ready(tina_future* future){
+	return _TINA_ATOMIC_LOAD(&future->_ready) != 0;
+}
+
+uintptr_t tina_future_await(tina_job* job, tina_future* future){
+	// The value is written before the flag is released, so it's safe to read once the flag is set.
+	if(_TINA_ATOMIC_LOAD(&future->_ready)) return future->_value;
+	
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	_tina_scheduler_lock(sched);
+	if(future->_ready){
+		_TINA_MUTEX_UNLOCK(sched->_lock);
+	} else {
+		_tina_future_pend(future);
+		_tina_job_wait(sched, job, &future->_group, 0);
+	}
+	return future->_value;
+}
+
+static void _tina_future_all_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	tina_future* out = (tina_future*)job->desc.user_data;
+	_tina_scheduler_lock(sched);
+	if(--out->_remaining == 0) _tina_future_fulfill(sched, out, job->desc.user_idx);
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+void tina_future_when_all(tina_scheduler* sched, tina_future* out, tina_future* const futures[], unsigned count, unsigned queue_idx){
+	tina_job_description desc = {.name = "tina_future_when_all", .func = _tina_future_all_job, .user_data = out, .user_idx = count, .queue_idx = queue_idx};
+	_tina_scheduler_lock(sched); {
+		// Count the futures that are already done now, and attach continuations to the rest.
+		out->_remaining = count;
+		for(unsigned i = 0; i < count; i++){
+			if(futures[i]->_ready){
+				out->_remaining--;
+			} else {
+				_tina_future_pend(futures[i]);
+				_tina_group_then(sched, &futures[i]->_group, 0, &desc);
+			}
+		}
+		if(out->_remaining == 0) _tina_future_fulfill(sched, out, count);
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+static void _tina_future_any_job(tina_job* job){
+	tina_scheduler* sched = tina_job_get_scheduler(job);
+	tina_future* out = (tina_future*)job->desc.user_data;
+	_tina_scheduler_lock(sched);
+	if(!out->_ready) _tina_future_fulfill(sched, out, job->desc.user_idx);
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+void tina_future_when_any(tina_scheduler* sched, tina_future* out, tina_future* const futures[], unsigned count, unsigned queue_idx){
+	_TINA_ASSERT(count > 0, "Tina Jobs Error: when_any requires at least one future.");
+	_tina_scheduler_lock(sched); {
+		for(unsigned i = 0; i < count; i++){
+			if(futures[i]->_ready){
+				_tina_future_fulfill(sched, out, i);
+				break;
+			}
+		}
+		
+		for(unsigned i = 0; i < count && !out->_ready; i++){
+			tina_job_description desc = {.name = "tina_future_when_any", .func = _tina_future_any_job, .user_data = out, .user_idx = i, .queue_idx = queue_idx};
+			_tina_future_pend(futures[i]);
+			_tina_group_then(sched, &futures[i]->_group, 0, &desc);
+		}
+	} _TINA_MUTEX_UNLOCK(sched->_lock);
+}
+
+unsigned tina_group_wait_blocking(tina_scheduler* sched, tina_group* group, unsigned threshold, unsigned queue_idx){
+	_tina_scheduler_lock(sched);
+	_tina_queue* queue = queue_idx == TINA_NO_QUEUE ? NULL : _tina_get_queue(sched, queue_idx);
+	_tina_blocked blocked = {.group = group, .threshold = threshold, .queue = queue, .next = NULL};
+	_tina_blocked_link(sched, &blocked);
+	
+	while(!_tina_blocked_ready(&blocked)){
+		if(queue){
+			// Loop again if the queue was interrupted, the group isn't done yet.
+			_tina_scheduler_run_locked(sched, queue_idx, TINA_RUN_LOOP, queue->interrupt_stamp, &blocked, 0, 0);
+		} else {
+			_TINA_COND_WAIT(sched->_blocked_signal, sched->_lock);
+		}
+	}
+	
+	_tina_blocked_unlink(sched, &blocked);
+	unsigned count = group->_count;
+	_TINA_MUTEX_UNLOCK(sched->_lock);
+	return count;
+}
+
 #endif // TINA_JOB_IMPLEMENTATION
 
 #ifdef __cplusplus